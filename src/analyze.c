@@ -0,0 +1,266 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "analyze.h"
+#include "chip8.h"
+#include "inst.h"
+
+static uint16_t
+analyze_word(const struct analyze* analyze, long addr)
+{
+    long mask = analyze->mem_size - 1;
+    return analyze->mem[addr & mask] << 8 | analyze->mem[(addr + 1) & mask];
+}
+
+// Find where control can go after the instruction at addr, returning
+// true if it ends a basic block rather than just falling through
+static bool
+analyze_successors(const struct analyze* analyze, long addr, const struct instruction* inst, uint16_t next[2], int* count)
+{
+    long mask = analyze->mem_size - 1;
+    long size = inst->opcode == OPCODE_LD_F000 ? 4 : 2;
+    uint16_t fall = (addr + size) & mask;
+
+    switch (inst->opcode) {
+    case OPCODE_SYS_0nnn:
+    case OPCODE_JP_1nnn:
+        next[0] = inst->nnn;
+        *count = 1;
+        return true;
+    case OPCODE_CALL_2nnn:
+        next[0] = inst->nnn;
+        next[1] = fall;
+        *count = 2;
+        return true;
+    case OPCODE_RET_00EE:
+    case OPCODE_EXIT_00FD:
+    case OPCODE_JP_Bnnn:
+        *count = 0;
+        return true;
+    case OPCODE_SE_3xkk:
+    case OPCODE_SNE_4xkk:
+    case OPCODE_SE_5xy0:
+    case OPCODE_SNE_9xy0:
+    case OPCODE_SKP_Ex9E:
+    case OPCODE_SKNP_ExA1: {
+        // skipping over F000 skips all four bytes of it
+        long skip = analyze_word(analyze, fall) == 0xF000 ? 4 : 2;
+        next[0] = fall;
+        next[1] = (fall + skip) & mask;
+        *count = 2;
+        return true;
+    }
+    default:
+        next[0] = fall;
+        *count = 1;
+        return false;
+    }
+}
+
+// Follow every path from the entry point, marking instructions as they
+// are decoded. Each instruction is decoded once and pushes at most two
+// successors, which bounds the size of the work stack.
+static int
+analyze_trace(struct analyze* analyze)
+{
+    long mask = analyze->mem_size - 1;
+    uint16_t* stack = malloc((2 * analyze->mem_size + 1) * sizeof(*stack));
+    if (stack == NULL) return ANALYZE_ERROR_ALLOC;
+
+    long top = 0;
+    stack[top++] = CHIP8_ROM_ADDR;
+    analyze->flags[CHIP8_ROM_ADDR] |= ANALYZE_LEADER;
+
+    while (top > 0) {
+        long addr = stack[--top];
+        for (;;) {
+            uint8_t* flags = &analyze->flags[addr];
+
+            // falling into code that was already traced joins two paths
+            if (*flags & ANALYZE_START) {
+                *flags |= ANALYZE_LEADER;
+                break;
+            }
+            if (*flags & ANALYZE_BAD) break;
+
+            struct instruction inst = { 0 };
+            if (instruction_decode(&inst, analyze_word(analyze, addr)) != INSTRUCTION_OK) {
+                *flags |= ANALYZE_BAD;
+                analyze->bad_words += 1;
+                break;
+            }
+
+            long size = inst.opcode == OPCODE_LD_F000 ? 4 : 2;
+            for (long i = 0; i < size; i++) analyze->flags[(addr + i) & mask] |= ANALYZE_CODE;
+            *flags |= ANALYZE_START;
+            analyze->histogram[inst.opcode] += 1;
+            analyze->instructions += 1;
+            if (inst.opcode == OPCODE_JP_Bnnn) analyze->indirect_jumps += 1;
+
+            uint16_t next[2];
+            int count = 0;
+            if (!analyze_successors(analyze, addr, &inst, next, &count)) {
+                addr = next[0];
+                continue;
+            }
+
+            for (int i = 0; i < count; i++) {
+                analyze->flags[next[i]] |= ANALYZE_LEADER;
+                stack[top++] = next[i];
+            }
+            break;
+        }
+    }
+
+    free(stack);
+    return ANALYZE_OK;
+}
+
+// Record the bytes a store may write, given what is known about I
+static void
+analyze_store(struct analyze* analyze, long index, long size)
+{
+    if (index < 0) {
+        analyze->unknown_stores += 1;
+        return;
+    }
+
+    bool hit = false;
+    for (long i = 0; i < size; i++) {
+        uint8_t* flags = &analyze->flags[(index + i) & (analyze->mem_size - 1)];
+        *flags |= ANALYZE_WRITTEN;
+        if (*flags & ANALYZE_CODE) hit = true;
+    }
+    if (hit) analyze->self_modifying += 1;
+}
+
+// Split traced code into basic blocks and look for stores into code,
+// tracking I within each block from the LD I that sets it
+static int
+analyze_blocks(struct analyze* analyze)
+{
+    long mask = analyze->mem_size - 1;
+
+    long leaders = 0;
+    for (long addr = 0; addr < analyze->mem_size; addr++) {
+        uint8_t flags = analyze->flags[addr];
+        if ((flags & ANALYZE_LEADER) && (flags & ANALYZE_START)) leaders += 1;
+    }
+
+    analyze->blocks = calloc(leaders > 0 ? leaders : 1, sizeof(*analyze->blocks));
+    if (analyze->blocks == NULL) return ANALYZE_ERROR_ALLOC;
+
+    for (long addr = 0; addr < analyze->mem_size; addr++) {
+        uint8_t flags = analyze->flags[addr];
+        if (!(flags & ANALYZE_LEADER) || !(flags & ANALYZE_START)) continue;
+
+        struct analyze_block* block = &analyze->blocks[analyze->block_count++];
+        block->start = addr;
+
+        long index = -1;
+        long at = addr;
+        for (;;) {
+            struct instruction inst = { 0 };
+            instruction_decode(&inst, analyze_word(analyze, at));
+
+            switch (inst.opcode) {
+            case OPCODE_LD_Annn: index = inst.nnn; break;
+            case OPCODE_LD_F000: index = analyze_word(analyze, at + 2); break;
+            case OPCODE_LD_Fx33: analyze_store(analyze, index, 3); break;
+            case OPCODE_LD_5xy2: analyze_store(analyze, index, abs(inst.x - inst.y) + 1); break;
+            case OPCODE_LD_Fx55:
+                analyze_store(analyze, index, inst.x + 1);
+                index = -1;
+                break;
+            case OPCODE_ADD_Fx1E:
+            case OPCODE_LD_Fx29:
+            case OPCODE_LD_Fx30:
+            case OPCODE_LD_Fx65:
+                index = -1;
+                break;
+            }
+
+            block->end = at;
+            bool ends = analyze_successors(analyze, at, &inst, block->next, &block->count);
+            if (ends) break;
+
+            // stop at the next leader, or at a word that failed to decode
+            long next = block->next[0] & mask;
+            if ((analyze->flags[next] & ANALYZE_LEADER) || !(analyze->flags[next] & ANALYZE_START)) break;
+            at = next;
+        }
+    }
+
+    return ANALYZE_OK;
+}
+
+int
+analyze_rom(struct analyze* analyze, const uint8_t* rom, long size)
+{
+    assert(analyze != NULL);
+    assert(rom != NULL);
+
+    memset(analyze, 0, sizeof(*analyze));
+
+    // load through the emulator so that memory matches what would run
+    chip8_init(&analyze->chip8);
+    int rc = chip8_load(&analyze->chip8, rom, size);
+    if (rc == CHIP8_ERROR_OVERSIZED_ROM) return ANALYZE_ERROR_OVERSIZED_ROM;
+    if (rc != CHIP8_OK) return ANALYZE_ERROR_ALLOC;
+
+    analyze->mem = chip8_memory(&analyze->chip8);
+    analyze->mem_size = chip8_addr_mask(&analyze->chip8) + 1;
+    analyze->rom_size = size;
+    analyze->flags = calloc(analyze->mem_size, 1);
+    if (analyze->flags == NULL) {
+        analyze_free(analyze);
+        return ANALYZE_ERROR_ALLOC;
+    }
+
+    rc = analyze_trace(analyze);
+    if (rc == ANALYZE_OK) rc = analyze_blocks(analyze);
+    if (rc != ANALYZE_OK) {
+        analyze_free(analyze);
+        return rc;
+    }
+
+    for (long addr = CHIP8_ROM_ADDR; addr < CHIP8_ROM_ADDR + size; addr++) {
+        if (!(analyze->flags[addr] & ANALYZE_CODE)) analyze->data_bytes += 1;
+    }
+
+    const long* h = analyze->histogram;
+    analyze->schip = h[OPCODE_SCD_00Cn] || h[OPCODE_SCR_00FB] || h[OPCODE_SCL_00FC] ||
+        h[OPCODE_EXIT_00FD] || h[OPCODE_LOW_00FE] || h[OPCODE_HIGH_00FF] ||
+        h[OPCODE_DRW_Dxy0] || h[OPCODE_LD_Fx30] || h[OPCODE_LD_Fx75] || h[OPCODE_LD_Fx85];
+    analyze->xochip = h[OPCODE_LD_5xy2] || h[OPCODE_LD_5xy3] || h[OPCODE_LD_F000] ||
+        h[OPCODE_PLANE_Fn01] || h[OPCODE_AUDIO_F002] || h[OPCODE_LD_Fx3A] ||
+        size + CHIP8_ROM_ADDR >= CHIP8_MEM_SIZE;
+
+    return ANALYZE_OK;
+}
+
+void
+analyze_free(struct analyze* analyze)
+{
+    assert(analyze != NULL);
+
+    chip8_free(&analyze->chip8);
+    free(analyze->flags);
+    free(analyze->blocks);
+    analyze->flags = NULL;
+    analyze->blocks = NULL;
+}
+
+const char*
+analyze_error_message(int error)
+{
+    switch (error) {
+    case ANALYZE_OK: return "OK";
+    case ANALYZE_ERROR_OVERSIZED_ROM: return "ROM is too large for memory";
+    case ANALYZE_ERROR_ALLOC: return "failed to allocate memory";
+    default: return "unknown error";
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef SKYLARK_ANALYZE_H_INCLUDED
+#define SKYLARK_ANALYZE_H_INCLUDED
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "chip8.h"
+#include "inst.h"
+
+// Flags kept for every byte of memory
+enum {
+    ANALYZE_CODE = 1 << 0,      // part of a reachable instruction
+    ANALYZE_START = 1 << 1,     // a reachable instruction starts here
+    ANALYZE_LEADER = 1 << 2,    // a basic block starts here
+    ANALYZE_BAD = 1 << 3,       // a reachable word that does not decode
+    ANALYZE_WRITTEN = 1 << 4,   // a store with a known I may write here
+};
+
+enum analyze_status {
+    ANALYZE_OK = 0,
+    ANALYZE_ERROR_OVERSIZED_ROM,
+    ANALYZE_ERROR_ALLOC,
+};
+
+// A basic block runs from start through the instruction at end. Calls
+// have two successors: the callee and the instruction after the call.
+struct analyze_block {
+    uint16_t start;
+    uint16_t end;
+    uint16_t next[2];
+    int count;
+};
+
+// Everything recovered from one ROM by following 1nnn / 2nnn / skips /
+// 00EE from the entry point. Bnnn jumps are indirect and not followed,
+// so code reached only through them is reported as data.
+struct analyze {
+    struct chip8 chip8;
+    const uint8_t* mem;
+    long mem_size;
+    long rom_size;
+    uint8_t* flags;
+
+    struct analyze_block* blocks;
+    long block_count;
+
+    long histogram[OPCODE_COUNT];
+    long instructions;
+    long data_bytes;
+    long bad_words;
+    long indirect_jumps;
+    long self_modifying;
+    long unknown_stores;
+    bool schip;
+    bool xochip;
+};
+
+int analyze_rom(struct analyze* analyze, const uint8_t* rom, long size);
+void analyze_free(struct analyze* analyze);
+const char* analyze_error_message(int error);
+
+#endif
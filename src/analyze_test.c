@@ -0,0 +1,60 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "analyze.c"
+
+bool
+test_analyze_rom(void)
+{
+    const uint8_t rom[] = {
+        0x22, 0x0a,  // 200: CALL 20a
+        0x30, 0x00,  // 202: SE V0, 0
+        0x12, 0x04,  // 204: JP 204
+        0x12, 0x06,  // 206: JP 206
+        0xff, 0xff,  // 208: data
+        0xa2, 0x0e,  // 20a: LD I, 20e
+        0xf0, 0x55,  // 20c: LD [I], V0
+        0x00, 0xee,  // 20e: RET
+    };
+
+    struct analyze analyze;
+    int rc = analyze_rom(&analyze, rom, sizeof(rom));
+    if (rc != ANALYZE_OK) {
+        fprintf(stderr, "analyze_rom failed: %s\n", analyze_error_message(rc));
+        return false;
+    }
+
+    bool ok = true;
+    if (analyze.instructions != 7 || analyze.data_bytes != 2 || analyze.bad_words != 0) {
+        fprintf(stderr, "traced %ld instructions, %ld data bytes and %ld bad words\n",
+            analyze.instructions, analyze.data_bytes, analyze.bad_words);
+        ok = false;
+    }
+    if (analyze.self_modifying != 1 || !(analyze.flags[0x20e] & ANALYZE_WRITTEN)) {
+        fprintf(stderr, "missed the store into the RET at 20e\n");
+        ok = false;
+    }
+
+    // entry, callee, return site and both sides of the skip
+    const struct analyze_block* first = &analyze.blocks[0];
+    if (analyze.block_count != 5 || first->start != 0x200 || first->count != 2 ||
+        first->next[0] != 0x20a || first->next[1] != 0x202) {
+        fprintf(stderr, "recovered the wrong control-flow graph: %ld blocks\n", analyze.block_count);
+        ok = false;
+    }
+    analyze_free(&analyze);
+
+    // a skip can land on a word that would fault at runtime
+    const uint8_t bad[] = { 0x30, 0x00, 0xff, 0xff, 0x12, 0x04 };
+    rc = analyze_rom(&analyze, bad, sizeof(bad));
+    if (rc != ANALYZE_OK || analyze.bad_words != 1 || !(analyze.flags[0x202] & ANALYZE_BAD)) {
+        fprintf(stderr, "missed the reachable bad word at 202\n");
+        ok = false;
+    }
+    analyze_free(&analyze);
+
+    return ok;
+}
@@ -0,0 +1,161 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cache.h"
+#include "chip8.h"
+#include "hash.h"
+#include "inst.h"
+
+// Process-wide registry of shared images, keyed by the hash of memory
+static pthread_mutex_t CACHE_LOCK = PTHREAD_MUTEX_INITIALIZER;
+static struct cache_shared* CACHE_SHARED = NULL;
+
+// Decode the instruction at addr along with any fusion that starts there,
+// returning false if it is not a valid instruction
+static bool
+cache_decode(struct cache_entry* entry, const uint8_t* mem, uint16_t addr)
+{
+    uint16_t code = mem[addr] << 8 | mem[addr + 1];
+    struct instruction inst = { 0 };
+    if (instruction_decode(&inst, code) != INSTRUCTION_OK) return false;
+
+    // look ahead for a sequence to fuse, without running off the end of memory
+    int opcodes[INSTRUCTION_FUSION_MAX] = { inst.opcode };
+    long count = 1;
+    while (count < INSTRUCTION_FUSION_MAX && addr + (count + 1) * 2 <= CHIP8_MEM_SIZE) {
+        long next = addr + count * 2;
+        struct instruction follow = { 0 };
+        if (instruction_decode(&follow, mem[next] << 8 | mem[next + 1]) != INSTRUCTION_OK) break;
+        opcodes[count++] = follow.opcode;
+    }
+
+    entry->code = code;
+    entry->opcode = inst.opcode;
+    entry->fusion = instruction_fuse(opcodes, count);
+    return true;
+}
+
+void
+cache_init(struct cache* cache)
+{
+    assert(cache != NULL);
+
+    // all pages start out uncached until the cache is attached to an image
+    memset(cache, 0, sizeof(*cache));
+}
+
+int
+cache_attach(struct cache* cache, const uint8_t* mem)
+{
+    assert(cache != NULL);
+    assert(mem != NULL);
+
+    cache_release(cache);
+
+    uint64_t hash = hash_finish(hash_update_wide(HASH_BASIS, mem, CHIP8_MEM_SIZE));
+
+    pthread_mutex_lock(&CACHE_LOCK);
+    struct cache_shared* shared = CACHE_SHARED;
+    while (shared != NULL && shared->hash != hash) shared = shared->next;
+
+    // the first machine to start from an image decodes all of it, so every
+    // later one starts warm and the shared pages are never written again
+    if (shared == NULL) {
+        shared = calloc(1, sizeof(*shared));
+        if (shared == NULL) {
+            pthread_mutex_unlock(&CACHE_LOCK);
+            return CACHE_ERROR_ALLOC;
+        }
+        shared->hash = hash;
+        for (long addr = 0; addr < CHIP8_MEM_SIZE; addr++) {
+            struct cache_entry* entry = &shared->pages[addr / CACHE_PAGE_SIZE].entries[addr % CACHE_PAGE_SIZE];
+            cache_decode(entry, mem, addr);
+        }
+        shared->next = CACHE_SHARED;
+        CACHE_SHARED = shared;
+    }
+    shared->refs += 1;
+    pthread_mutex_unlock(&CACHE_LOCK);
+
+    cache->shared = shared;
+    for (long i = 0; i < CACHE_PAGES; i++) cache->pages[i] = &shared->pages[i];
+
+    return CACHE_OK;
+}
+
+const struct cache_entry*
+cache_lookup(struct cache* cache, const uint8_t* mem, uint16_t addr)
+{
+    assert(cache != NULL);
+    assert(addr < CHIP8_MEM_SIZE);
+
+    long page = addr / CACHE_PAGE_SIZE;
+    uint16_t code = mem[addr] << 8 | mem[addr + 1];
+    if (cache->pages[page] != NULL) {
+        const struct cache_entry* entry = &cache->pages[page]->entries[addr % CACHE_PAGE_SIZE];
+        if (entry->opcode != OPCODE_UNDEFINED && entry->code == code) return entry;
+    }
+
+    // misses fill private pages, but shared and uncached pages are never
+    // written so those decode into scratch space instead
+    struct cache_entry* entry = &cache->scratch;
+    if (cache->owned[page] != NULL) entry = &cache->owned[page]->entries[addr % CACHE_PAGE_SIZE];
+
+    if (!cache_decode(entry, mem, addr)) return NULL;
+    return entry;
+}
+
+void
+cache_invalidate(struct cache* cache, long addr, long size)
+{
+    assert(cache != NULL);
+
+    // an entry reads two bytes and a fusion up to two more instructions,
+    // so anything starting up to this far before the write may be stale
+    long reach = INSTRUCTION_FUSION_MAX * 2 - 1;
+    for (long i = addr - reach; i < addr + size; i++) {
+        long at = i & CHIP8_ADDR_MASK;
+        long page = at / CACHE_PAGE_SIZE;
+        if (cache->pages[page] == NULL) continue;
+
+        // copy a shared page on the first write to it, or leave it
+        // uncached if there is no memory for the copy
+        if (cache->owned[page] == NULL) {
+            struct cache_page* copy = malloc(sizeof(*copy));
+            if (copy != NULL) memcpy(copy, cache->pages[page], sizeof(*copy));
+            cache->owned[page] = copy;
+            cache->pages[page] = copy;
+            if (copy == NULL) continue;
+        }
+
+        cache->owned[page]->entries[at % CACHE_PAGE_SIZE].opcode = OPCODE_UNDEFINED;
+    }
+}
+
+void
+cache_release(struct cache* cache)
+{
+    assert(cache != NULL);
+
+    for (long i = 0; i < CACHE_PAGES; i++) free(cache->owned[i]);
+
+    // the last machine to let go of a shared image frees it
+    struct cache_shared* shared = cache->shared;
+    if (shared != NULL) {
+        pthread_mutex_lock(&CACHE_LOCK);
+        shared->refs -= 1;
+        if (shared->refs == 0) {
+            struct cache_shared** link = &CACHE_SHARED;
+            while (*link != shared) link = &(*link)->next;
+            *link = shared->next;
+            free(shared);
+        }
+        pthread_mutex_unlock(&CACHE_LOCK);
+    }
+
+    cache_init(cache);
+}
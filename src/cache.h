@@ -0,0 +1,57 @@
+#ifndef SKYLARK_CACHE_H_INCLUDED
+#define SKYLARK_CACHE_H_INCLUDED
+
+#include <stdint.h>
+
+#include "chip8.h"
+
+enum {
+    CACHE_PAGE_SIZE = 256,
+    CACHE_PAGES = CHIP8_MEM_SIZE / CACHE_PAGE_SIZE,
+};
+
+enum cache_status {
+    CACHE_OK = 0,
+    CACHE_ERROR_ALLOC,
+};
+
+// A decoded instruction, tagged with the code it was decoded from. An
+// entry whose tag no longer matches memory is simply decoded again.
+struct cache_entry {
+    uint16_t code;
+    uint8_t opcode;
+    uint8_t fusion;
+};
+
+struct cache_page {
+    struct cache_entry entries[CACHE_PAGE_SIZE];
+};
+
+// Fully decoded pages for one initial memory image, shared read-only by
+// every machine that starts from that image
+struct cache_shared {
+    uint64_t hash;
+    long refs;
+    struct cache_shared* next;
+    struct cache_page pages[CACHE_PAGES];
+};
+
+// Each machine's view of the decode cache. Pages point into the shared
+// image until the machine writes to them through Fx33 / Fx55, at which
+// point it gets a private copy of just that page. Writes invalidate the
+// entries that could have read those bytes, including fusions that
+// started up to two instructions earlier. A NULL page is uncached.
+struct cache {
+    const struct cache_page* pages[CACHE_PAGES];
+    struct cache_page* owned[CACHE_PAGES];
+    struct cache_shared* shared;
+    struct cache_entry scratch;
+};
+
+void cache_init(struct cache* cache);
+int cache_attach(struct cache* cache, const uint8_t* mem);
+const struct cache_entry* cache_lookup(struct cache* cache, const uint8_t* mem, uint16_t addr);
+void cache_invalidate(struct cache* cache, long addr, long size);
+void cache_release(struct cache* cache);
+
+#endif
@@ -0,0 +1,130 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cache.c"
+
+bool
+test_cache_fusion(void)
+{
+    // a loop built from every fusion, which then rewrites its own ADD
+    const uint8_t rom[] = {
+        0x60, 0x05,  // 200: LD V0, 5
+        0xa0, 0x00,  // 202: LD I, 000
+        0xd0, 0x15,  // 204: DRW V0, V1, 5
+        0xf1, 0x07,  // 206: LD V1, DT
+        0x31, 0x00,  // 208: SE V1, 0
+        0x72, 0x01,  // 20a: ADD V2, 1
+        0x32, 0x40,  // 20c: SE V2, 40
+        0x12, 0x0a,  // 20e: JP 20a
+        0x60, 0x72,  // 210: LD V0, 72
+        0x61, 0x02,  // 212: LD V1, 02
+        0xa2, 0x0a,  // 214: LD I, 20a
+        0xf1, 0x55,  // 216: LD [I], V1
+        0x62, 0x00,  // 218: LD V2, 0
+        0x12, 0x02,  // 21a: JP 202
+    };
+
+    // each timing model ends frames differently, and fusions must agree with all of them
+    const int profiles[] = { CHIP8_PROFILE_DEFAULT, CHIP8_PROFILE_CHIP8, CHIP8_PROFILE_SCHIP };
+    const int timings[] = { CHIP8_TIMING_STEPS, CHIP8_TIMING_VIP, CHIP8_TIMING_VIP_VBLANK };
+    for (size_t p = 0; p < sizeof(profiles) / sizeof(*profiles); p++) {
+        for (size_t t = 0; t < sizeof(timings) / sizeof(*timings); t++) {
+            struct cache cache;
+            struct chip8 plain = { 0 };
+            struct chip8 fused = { 0 };
+            cache_init(&cache);
+            chip8_init(&plain);
+            chip8_init(&fused);
+            fused.cache = &cache;
+            chip8_load(&plain, rom, sizeof(rom));
+            chip8_load(&fused, rom, sizeof(rom));
+            plain.rng = fused.rng = 1;
+            plain.quirks = fused.quirks = profiles[p];
+            plain.timer_delay = fused.timer_delay = 30;
+            chip8_set_timing(&plain, timings[t]);
+            chip8_set_timing(&fused, timings[t]);
+
+            for (long frame = 0; frame < 100; frame++) {
+                int rc = chip8_frame(&plain);
+                if (rc != CHIP8_OK || chip8_frame(&fused) != rc) {
+                    fprintf(stderr, "frame %ld failed to run\n", frame);
+                    return false;
+                }
+                if (chip8_hash(&plain) != chip8_hash(&fused)) {
+                    fprintf(stderr, "fused state diverged at frame %ld with quirks %d and timing %d\n",
+                        frame, profiles[p], timings[t]);
+                    return false;
+                }
+            }
+
+            // the rewritten ADD must have been decoded again
+            const struct cache_entry* entry = cache_lookup(&cache, fused.mem, 0x20a);
+            if (entry->code != 0x7202 || entry->fusion != FUSION_ADD_7xkk_SE_3xkk_JP_1nnn) {
+                fprintf(stderr, "cache entry at 20a is stale: %04x\n", entry->code);
+                return false;
+            }
+            cache_release(&cache);
+        }
+    }
+
+    return true;
+}
+
+bool
+test_cache_shared(void)
+{
+    // writes a byte into the page holding the ROM, then spins
+    const uint8_t rom[] = {
+        0x60, 0x01,  // 200: LD V0, 1
+        0xa3, 0x80,  // 202: LD I, 380
+        0xf0, 0x55,  // 204: LD [I], V0
+        0x12, 0x06,  // 206: JP 206
+    };
+
+    struct cache caches[2];
+    struct chip8 machines[2] = { 0 };
+    for (long i = 0; i < 2; i++) {
+        cache_init(&caches[i]);
+        chip8_init(&machines[i]);
+        machines[i].cache = &caches[i];
+        chip8_load(&machines[i], rom, sizeof(rom));
+    }
+
+    struct cache_shared* shared = caches[0].shared;
+    if (shared == NULL || caches[1].shared != shared || shared->refs != 2) {
+        fprintf(stderr, "machines running the same ROM do not share a cache\n");
+        return false;
+    }
+
+    // the shared image is decoded up front, so the first lookup already hits
+    const struct cache_entry* entry = cache_lookup(&caches[1], machines[1].mem, 0x206);
+    if (entry != &shared->pages[2].entries[6] || entry->opcode != OPCODE_JP_1nnn) {
+        fprintf(stderr, "shared cache was not decoded ahead of time\n");
+        return false;
+    }
+
+    // only the writer gets a private copy of the page it wrote to
+    for (long step = 0; step < 3; step++) chip8_step(&machines[0]);
+    if (caches[0].owned[3] == NULL || caches[0].pages[3] != caches[0].owned[3]) {
+        fprintf(stderr, "written page was not copied\n");
+        return false;
+    }
+    if (caches[0].pages[2] != &shared->pages[2] || caches[1].pages[3] != &shared->pages[3]) {
+        fprintf(stderr, "untouched pages are no longer shared\n");
+        return false;
+    }
+
+    cache_release(&caches[0]);
+    cache_release(&caches[1]);
+    for (struct cache_shared* s = CACHE_SHARED; s != NULL; s = s->next) {
+        if (s == shared) {
+            fprintf(stderr, "released shared cache is still registered\n");
+            return false;
+        }
+    }
+
+    return true;
+}
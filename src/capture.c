@@ -0,0 +1,385 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "capture.h"
+#include "chip8.h"
+#include "hash.h"
+
+enum {
+    CAPTURE_WIDTH = CHIP8_DISPLAY_WIDTH,
+    CAPTURE_HEIGHT = CHIP8_DISPLAY_HEIGHT,
+    CAPTURE_PNG_ROW = CAPTURE_WIDTH + 1,
+    CAPTURE_PNG_DATA = CAPTURE_PNG_ROW * CAPTURE_HEIGHT,
+};
+
+// Gray levels for each combination of the two planes: off, the first
+// plane, the second plane, and both
+static const uint8_t CAPTURE_GRAY[1 << CHIP8_PLANES] = { 0x00, 0xff, 0x55, 0xaa };
+
+// Frames are always written at the high resolution, with each low
+// resolution pixel doubled in both directions
+static int
+capture_pixel(const struct capture_frame* frame, long x, long y)
+{
+    if (!frame->hires) {
+        x /= 2;
+        y /= 2;
+    }
+
+    int color = 0;
+    for (long p = 0; p < CHIP8_PLANES; p++) {
+        color |= ((frame->display[p][y][x / 64] >> (63 - (x % 64))) & 1) << p;
+    }
+    return color;
+}
+
+static uint32_t CAPTURE_CRC_TABLE[256];
+static pthread_once_t CAPTURE_CRC_ONCE = PTHREAD_ONCE_INIT;
+
+static void
+capture_crc_init(void)
+{
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+        }
+        CAPTURE_CRC_TABLE[n] = c;
+    }
+}
+
+static uint32_t
+capture_crc(uint32_t crc, const uint8_t* data, long size)
+{
+    crc = ~crc;
+    for (long i = 0; i < size; i++) {
+        crc = CAPTURE_CRC_TABLE[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static void
+capture_put32(uint8_t* out, uint32_t value)
+{
+    out[0] = value >> 24;
+    out[1] = value >> 16;
+    out[2] = value >> 8;
+    out[3] = value;
+}
+
+static bool
+capture_png_chunk(FILE* fp, const char* type, const uint8_t* data, uint32_t size)
+{
+    uint8_t header[8] = { 0 };
+    capture_put32(header, size);
+    memcpy(header + 4, type, 4);
+
+    uint32_t crc = capture_crc(0, header + 4, 4);
+    crc = capture_crc(crc, data, size);
+
+    uint8_t footer[4] = { 0 };
+    capture_put32(footer, crc);
+
+    if (fwrite(header, 1, sizeof(header), fp) != sizeof(header)) return false;
+    if (size > 0 && fwrite(data, 1, size, fp) != size) return false;
+    if (fwrite(footer, 1, sizeof(footer), fp) != sizeof(footer)) return false;
+    return true;
+}
+
+// PNGs are written as 8-bit grayscale with a single "stored" deflate
+// block so that no compression library is needed for a 2 KB image.
+static int
+capture_write_png(struct capture* capture, const struct capture_frame* frame)
+{
+    static const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+    char path[CAPTURE_PATH_SIZE + 32] = { 0 };
+    snprintf(path, sizeof(path), "%s/frame_%08ld.png", capture->png_dir, frame->number);
+
+    FILE* fp = fopen(path, "wb");
+    if (fp == NULL) return CAPTURE_ERROR_OPEN;
+
+    uint8_t ihdr[13] = { 0 };
+    capture_put32(ihdr + 0, CAPTURE_WIDTH);
+    capture_put32(ihdr + 4, CAPTURE_HEIGHT);
+    ihdr[8] = 8;  // bit depth
+    ihdr[9] = 0;  // grayscale
+
+    // zlib header + one final stored block + adler32 trailer
+    uint8_t idat[2 + 5 + CAPTURE_PNG_DATA + 4] = { 0x78, 0x01 };
+    uint8_t* block = idat + 2;
+    block[0] = 0x01;
+    block[1] = CAPTURE_PNG_DATA & 0xff;
+    block[2] = CAPTURE_PNG_DATA >> 8;
+    block[3] = ~block[1];
+    block[4] = ~block[2];
+
+    uint8_t* raw = block + 5;
+    for (long y = 0; y < CAPTURE_HEIGHT; y++) {
+        uint8_t* row = raw + (y * CAPTURE_PNG_ROW);
+        row[0] = 0;  // filter type "none"
+        for (long x = 0; x < CAPTURE_WIDTH; x++) {
+            row[1 + x] = CAPTURE_GRAY[capture_pixel(frame, x, y)];
+        }
+    }
+
+    uint32_t a = 1, b = 0;
+    for (long i = 0; i < CAPTURE_PNG_DATA; i++) {
+        a = (a + raw[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    capture_put32(raw + CAPTURE_PNG_DATA, (b << 16) | a);
+
+    bool ok = fwrite(signature, 1, sizeof(signature), fp) == sizeof(signature);
+    ok = ok && capture_png_chunk(fp, "IHDR", ihdr, sizeof(ihdr));
+    ok = ok && capture_png_chunk(fp, "IDAT", idat, sizeof(idat));
+    ok = ok && capture_png_chunk(fp, "IEND", NULL, 0);
+    if (fclose(fp) != 0) ok = false;
+
+    return ok ? CAPTURE_OK : CAPTURE_ERROR_WRITE;
+}
+
+// Y4M streams have a constant frame rate, so a frame identical to its
+// predecessor repeats the last picture rather than being dropped
+static int
+capture_write_y4m(struct capture* capture, const struct capture_frame* frame)
+{
+    if (frame->has_pixels) {
+        for (long y = 0; y < CAPTURE_HEIGHT; y++) {
+            for (long x = 0; x < CAPTURE_WIDTH; x++) {
+                // Y4M luma uses the limited "video" range of 16 to 235
+                capture->luma[y][x] = 16 + CAPTURE_GRAY[capture_pixel(frame, x, y)] * 219 / 255;
+            }
+        }
+    }
+
+    if (fputs("FRAME\n", capture->video) == EOF) return CAPTURE_ERROR_WRITE;
+    if (fwrite(capture->luma, 1, sizeof(capture->luma), capture->video) != sizeof(capture->luma)) {
+        return CAPTURE_ERROR_WRITE;
+    }
+    return CAPTURE_OK;
+}
+
+static int
+capture_write(struct capture* capture, const struct capture_frame* frame)
+{
+    if (capture->hashes != NULL) {
+        // hashes are logged as little-endian 64-bit words, one per frame
+        uint8_t bytes[8] = { 0 };
+        for (long i = 0; i < 8; i++) bytes[i] = frame->hash >> (i * 8);
+        if (fwrite(bytes, 1, sizeof(bytes), capture->hashes) != sizeof(bytes)) {
+            return CAPTURE_ERROR_WRITE;
+        }
+    }
+
+    switch (capture->format) {
+    case CAPTURE_FORMAT_Y4M: return capture_write_y4m(capture, frame);
+    case CAPTURE_FORMAT_PNG: return frame->has_pixels ? capture_write_png(capture, frame) : CAPTURE_OK;
+    default: return CAPTURE_OK;
+    }
+}
+
+static void*
+capture_writer(void* arg)
+{
+    struct capture* capture = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&capture->lock);
+        while (capture->count == 0 && !capture->done) {
+            pthread_cond_wait(&capture->not_empty, &capture->lock);
+        }
+        if (capture->count == 0 && capture->done) {
+            pthread_mutex_unlock(&capture->lock);
+            break;
+        }
+        const struct capture_frame* frame = &capture->queue[capture->head];
+        pthread_mutex_unlock(&capture->lock);
+
+        // the slot stays owned by the writer until head moves past it
+        int rc = capture_write(capture, frame);
+
+        pthread_mutex_lock(&capture->lock);
+        if (rc != CAPTURE_OK && capture->error == CAPTURE_OK) capture->error = rc;
+        capture->head = (capture->head + 1) % CAPTURE_QUEUE_SIZE;
+        capture->count -= 1;
+        pthread_cond_signal(&capture->not_full);
+        pthread_mutex_unlock(&capture->lock);
+    }
+
+    return NULL;
+}
+
+static FILE*
+capture_open_buffered(const char* path, char** buf)
+{
+    FILE* fp = fopen(path, "wb");
+    if (fp == NULL) return NULL;
+
+    // large buffers keep the writer thread to a few big write calls
+    *buf = malloc(CAPTURE_BUFFER_SIZE);
+    if (*buf != NULL) setvbuf(fp, *buf, _IOFBF, CAPTURE_BUFFER_SIZE);
+
+    return fp;
+}
+
+static void
+capture_release(struct capture* capture)
+{
+    if (capture->hashes != NULL) fclose(capture->hashes);
+    if (capture->video != NULL) fclose(capture->video);
+    free(capture->hashes_buf);
+    free(capture->video_buf);
+    free(capture->queue);
+
+    capture->hashes = NULL;
+    capture->video = NULL;
+    capture->hashes_buf = NULL;
+    capture->video_buf = NULL;
+    capture->queue = NULL;
+}
+
+uint64_t
+capture_hash(const struct chip8* chip8)
+{
+    assert(chip8 != NULL);
+
+    uint64_t hash = hash_bytes(chip8->display, sizeof(chip8->display));
+    return hash_update(hash, &chip8->hires, sizeof(chip8->hires));
+}
+
+int
+capture_open(struct capture* capture, const char* hashes_path, int format, const char* video_path)
+{
+    assert(capture != NULL);
+
+    memset(capture, 0, sizeof(*capture));
+    capture->format = format;
+    pthread_once(&CAPTURE_CRC_ONCE, capture_crc_init);
+
+    capture->queue = malloc(CAPTURE_QUEUE_SIZE * sizeof(*capture->queue));
+    if (capture->queue == NULL) return CAPTURE_ERROR_OPEN;
+
+    if (hashes_path != NULL) {
+        capture->hashes = capture_open_buffered(hashes_path, &capture->hashes_buf);
+        if (capture->hashes == NULL) {
+            capture_release(capture);
+            return CAPTURE_ERROR_OPEN;
+        }
+    }
+
+    if (format == CAPTURE_FORMAT_Y4M) {
+        assert(video_path != NULL);
+        capture->video = capture_open_buffered(video_path, &capture->video_buf);
+        if (capture->video == NULL) {
+            capture_release(capture);
+            return CAPTURE_ERROR_OPEN;
+        }
+        int rc = fprintf(capture->video, "YUV4MPEG2 W%d H%d F60:1 Ip A1:1 Cmono\n",
+            CAPTURE_WIDTH, CAPTURE_HEIGHT);
+        if (rc < 0) {
+            capture_release(capture);
+            return CAPTURE_ERROR_WRITE;
+        }
+    }
+
+    if (format == CAPTURE_FORMAT_PNG) {
+        assert(video_path != NULL);
+        snprintf(capture->png_dir, sizeof(capture->png_dir), "%s", video_path);
+    }
+
+    pthread_mutex_init(&capture->lock, NULL);
+    pthread_cond_init(&capture->not_empty, NULL);
+    pthread_cond_init(&capture->not_full, NULL);
+
+    if (pthread_create(&capture->thread, NULL, capture_writer, capture) != 0) {
+        pthread_cond_destroy(&capture->not_full);
+        pthread_cond_destroy(&capture->not_empty);
+        pthread_mutex_destroy(&capture->lock);
+        capture_release(capture);
+        return CAPTURE_ERROR_THREAD;
+    }
+
+    return CAPTURE_OK;
+}
+
+int
+capture_frame(struct capture* capture, const struct chip8* chip8)
+{
+    assert(capture != NULL);
+    assert(chip8 != NULL);
+
+    uint64_t hash = capture_hash(chip8);
+
+    // frames identical to the previous one skip copying the display: PNG
+    // sequences leave them out and Y4M repeats the last picture
+    bool has_pixels = capture->format != CAPTURE_FORMAT_NONE;
+    if (capture->frames > 0 && hash == capture->last_hash) has_pixels = false;
+
+    pthread_mutex_lock(&capture->lock);
+    while (capture->count == CAPTURE_QUEUE_SIZE) {
+        pthread_cond_wait(&capture->not_full, &capture->lock);
+    }
+    int error = capture->error;
+    long slot = (capture->head + capture->count) % CAPTURE_QUEUE_SIZE;
+    pthread_mutex_unlock(&capture->lock);
+
+    // the writer never touches slots beyond head + count
+    struct capture_frame* frame = &capture->queue[slot];
+    frame->hash = hash;
+    frame->number = capture->frames;
+    frame->has_pixels = has_pixels;
+    frame->hires = chip8->hires;
+    if (has_pixels) memcpy(frame->display, chip8->display, sizeof(frame->display));
+
+    pthread_mutex_lock(&capture->lock);
+    capture->count += 1;
+    pthread_cond_signal(&capture->not_empty);
+    pthread_mutex_unlock(&capture->lock);
+
+    capture->last_hash = hash;
+    capture->frames += 1;
+
+    return error;
+}
+
+int
+capture_close(struct capture* capture)
+{
+    assert(capture != NULL);
+
+    pthread_mutex_lock(&capture->lock);
+    capture->done = true;
+    pthread_cond_signal(&capture->not_empty);
+    pthread_mutex_unlock(&capture->lock);
+
+    pthread_join(capture->thread, NULL);
+
+    int error = capture->error;
+    if (capture->hashes != NULL && fflush(capture->hashes) != 0) error = CAPTURE_ERROR_WRITE;
+    if (capture->video != NULL && fflush(capture->video) != 0) error = CAPTURE_ERROR_WRITE;
+
+    pthread_cond_destroy(&capture->not_full);
+    pthread_cond_destroy(&capture->not_empty);
+    pthread_mutex_destroy(&capture->lock);
+    capture_release(capture);
+
+    return error;
+}
+
+const char*
+capture_error_message(int error)
+{
+    switch (error) {
+    case CAPTURE_OK: return "OK";
+    case CAPTURE_ERROR_OPEN: return "failed to open output";
+    case CAPTURE_ERROR_THREAD: return "failed to start writer thread";
+    case CAPTURE_ERROR_WRITE: return "failed to write output";
+    default: return "unknown error";
+    }
+}
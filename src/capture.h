@@ -0,0 +1,70 @@
+#ifndef SKYLARK_CAPTURE_H_INCLUDED
+#define SKYLARK_CAPTURE_H_INCLUDED
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "chip8.h"
+
+enum {
+    CAPTURE_QUEUE_SIZE = 256,
+    CAPTURE_BUFFER_SIZE = 1 << 20,
+    CAPTURE_PATH_SIZE = 4096,
+};
+
+enum capture_format {
+    CAPTURE_FORMAT_NONE = 0,
+    CAPTURE_FORMAT_Y4M,
+    CAPTURE_FORMAT_PNG,
+};
+
+enum capture_status {
+    CAPTURE_OK = 0,
+    CAPTURE_ERROR_OPEN,
+    CAPTURE_ERROR_THREAD,
+    CAPTURE_ERROR_WRITE,
+};
+
+struct capture_frame {
+    uint64_t hash;
+    long number;
+    bool has_pixels;
+    bool hires;
+    uint64_t display[CHIP8_PLANES][CHIP8_DISPLAY_HEIGHT][CHIP8_DISPLAY_WORDS];
+};
+
+// Frames are hashed on the emulation thread and handed off through a
+// bounded queue to a writer thread that owns all of the file I/O.
+struct capture {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+
+    struct capture_frame* queue;
+    long head;
+    long count;
+    bool done;
+
+    int format;
+    FILE* hashes;
+    FILE* video;
+    char* hashes_buf;
+    char* video_buf;
+    char png_dir[CAPTURE_PATH_SIZE];
+    uint8_t luma[CHIP8_DISPLAY_HEIGHT][CHIP8_DISPLAY_WIDTH];
+
+    uint64_t last_hash;
+    long frames;
+    int error;
+};
+
+uint64_t capture_hash(const struct chip8* chip8);
+int capture_open(struct capture* capture, const char* hashes_path, int format, const char* video_path);
+int capture_frame(struct capture* capture, const struct chip8* chip8);
+int capture_close(struct capture* capture);
+const char* capture_error_message(int error);
+
+#endif
@@ -0,0 +1,100 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "capture.c"
+
+bool
+test_capture_hash(void)
+{
+    struct chip8 a = { 0 };
+    chip8_init(&a);
+    struct chip8 b = { 0 };
+    chip8_init(&b);
+
+    if (capture_hash(&a) != capture_hash(&b)) {
+        fprintf(stderr, "capture_hash differs for identical displays\n");
+        return false;
+    }
+
+    b.display[0][1][0] = UINT64_C(1) << 62;
+    if (capture_hash(&a) == capture_hash(&b)) {
+        fprintf(stderr, "capture_hash matches for different displays\n");
+        return false;
+    }
+
+    b.display[0][1][0] = 0;
+    b.hires = true;
+    if (capture_hash(&a) == capture_hash(&b)) {
+        fprintf(stderr, "capture_hash matches for different resolutions\n");
+        return false;
+    }
+
+    // the CRC of an IEND chunk type is fixed by the PNG specification
+    pthread_once(&CAPTURE_CRC_ONCE, capture_crc_init);
+    uint32_t crc = capture_crc(0, (const uint8_t*)"IEND", 4);
+    if (crc != 0xae426082) {
+        fprintf(stderr, "capture_crc computed %08x for IEND\n", crc);
+        return false;
+    }
+
+    return true;
+}
+
+bool
+test_capture_y4m(void)
+{
+    const char* path = "skylark_capture_test.y4m";
+
+    struct capture capture;
+    int rc = capture_open(&capture, NULL, CAPTURE_FORMAT_Y4M, path);
+    if (rc != CAPTURE_OK) {
+        fprintf(stderr, "capture_open failed: %s\n", capture_error_message(rc));
+        return false;
+    }
+
+    // the second frame repeats the first, and must still be in the stream
+    struct chip8 chip8 = { 0 };
+    chip8_init(&chip8);
+    chip8.display[0][0][0] = UINT64_C(1) << 63;
+    capture_frame(&capture, &chip8);
+    capture_frame(&capture, &chip8);
+    chip8.display[0][0][0] = 0;
+    capture_frame(&capture, &chip8);
+
+    rc = capture_close(&capture);
+    if (rc != CAPTURE_OK) {
+        fprintf(stderr, "capture_close failed: %s\n", capture_error_message(rc));
+        return false;
+    }
+
+    static uint8_t data[3 * (6 + CAPTURE_WIDTH * CAPTURE_HEIGHT) + 64];
+    long size = 0;
+    FILE* fp = fopen(path, "rb");
+    if (fp != NULL) {
+        size = fread(data, 1, sizeof(data), fp);
+        fclose(fp);
+    }
+    remove(path);
+
+    const char* header = "YUV4MPEG2 W128 H64 F60:1 Ip A1:1 Cmono\n";
+    long frame_size = 6 + CAPTURE_WIDTH * CAPTURE_HEIGHT;
+    long header_size = strlen(header);
+    if (size != header_size + 3 * frame_size || memcmp(data, header, header_size) != 0) {
+        fprintf(stderr, "capture wrote %ld bytes of Y4M instead of a header and 3 frames\n", size);
+        return false;
+    }
+
+    // a lit low resolution pixel covers 2x2 high resolution pixels
+    const uint8_t* second = data + header_size + frame_size + 6;
+    const uint8_t* third = data + header_size + (2 * frame_size) + 6;
+    if (second[0] != 235 || second[1] != 235 || second[CAPTURE_WIDTH + 1] != 235 || second[2] != 16 || third[0] != 16) {
+        fprintf(stderr, "capture wrote the wrong pixels for a repeated frame\n");
+        return false;
+    }
+
+    return true;
+}
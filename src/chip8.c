@@ -1,13 +1,17 @@
 #include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
+#include "cache.h"
 #include "chip8.h"
+#include "hash.h"
 #include "inst.h"
 #include "op.h"
+#include "quirk.h"
 
 // Chip8 font information
 // 'A', for example:
@@ -35,15 +39,46 @@ static const uint8_t CHIP8_FONT[] = {
     0xf0, 0x80, 0xf0, 0x80, 0x80  /* F */
 };
 
+// SCHIP 8x10 font, stored right after the small one. SCHIP itself only
+// has the digits, so the letters follow the ones used by Octo.
+static const uint8_t CHIP8_BIG_FONT[] = {
+    0xff, 0xff, 0xc3, 0xc3, 0xc3, 0xc3, 0xc3, 0xc3, 0xff, 0xff, /* 0 */
+    0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xff, 0xff, /* 1 */
+    0xff, 0xff, 0x03, 0x03, 0xff, 0xff, 0xc0, 0xc0, 0xff, 0xff, /* 2 */
+    0xff, 0xff, 0x03, 0x03, 0xff, 0xff, 0x03, 0x03, 0xff, 0xff, /* 3 */
+    0xc3, 0xc3, 0xc3, 0xc3, 0xff, 0xff, 0x03, 0x03, 0x03, 0x03, /* 4 */
+    0xff, 0xff, 0xc0, 0xc0, 0xff, 0xff, 0x03, 0x03, 0xff, 0xff, /* 5 */
+    0xff, 0xff, 0xc0, 0xc0, 0xff, 0xff, 0xc3, 0xc3, 0xff, 0xff, /* 6 */
+    0xff, 0xff, 0x03, 0x03, 0x06, 0x0c, 0x18, 0x18, 0x18, 0x18, /* 7 */
+    0xff, 0xff, 0xc3, 0xc3, 0xff, 0xff, 0xc3, 0xc3, 0xff, 0xff, /* 8 */
+    0xff, 0xff, 0xc3, 0xc3, 0xff, 0xff, 0x03, 0x03, 0xff, 0xff, /* 9 */
+    0x7e, 0xff, 0xc3, 0xc3, 0xc3, 0xff, 0xff, 0xc3, 0xc3, 0xc3, /* A */
+    0xfc, 0xfc, 0xc3, 0xc3, 0xfc, 0xfc, 0xc3, 0xc3, 0xfc, 0xfc, /* B */
+    0x3c, 0xff, 0xc3, 0xc0, 0xc0, 0xc0, 0xc0, 0xc3, 0xff, 0x3c, /* C */
+    0xfc, 0xfe, 0xc3, 0xc3, 0xc3, 0xc3, 0xc3, 0xc3, 0xfe, 0xfc, /* D */
+    0xff, 0xff, 0xc0, 0xc0, 0xff, 0xff, 0xc0, 0xc0, 0xff, 0xff, /* E */
+    0xff, 0xff, 0xc0, 0xc0, 0xff, 0xff, 0xc0, 0xc0, 0xc0, 0xc0  /* F */
+};
+
+// fail the build if the hot state no longer fits in one cache line, or if
+// the timing model would overlap the quirk flags it shares a byte with
+typedef char chip8_hot_state_check[offsetof(struct chip8, input) <= CHIP8_CACHE_LINE ? 1 : -1];
+typedef char chip8_timing_check[CHIP8_QUIRK_COUNT == 1 << CHIP8_TIMING_SHIFT ? 1 : -1];
+
 int
 chip8_init(struct chip8* chip8)
 {
     assert(chip8 != NULL);
 
     memset(chip8, 0, sizeof(*chip8));
-    srand(time(NULL));
+
+    // each machine has its own RNG so that its state fully determines its future
+    chip8->rng = (uint32_t)time(NULL) | 1;
+    chip8->planes = 1;
 
     memmove(chip8->mem, CHIP8_FONT, sizeof(CHIP8_FONT));
+    memmove(chip8->mem + CHIP8_BIG_FONT_ADDR, CHIP8_BIG_FONT, sizeof(CHIP8_BIG_FONT));
+    memmove(chip8->mem + CHIP8_MEM_SIZE, chip8->mem, CHIP8_MEM_GUARD);
 
     return CHIP8_OK;
 }
@@ -53,47 +88,355 @@ chip8_load(struct chip8* chip8, const uint8_t* rom, long size)
 {
     assert(rom != NULL);
 
-    if (CHIP8_ROM_ADDR + size >= CHIP8_MEM_SIZE) {
+    return chip8_load_profile(chip8, rom, size, quirk_lookup(hash_bytes(rom, size)));
+}
+
+int
+chip8_load_profile(struct chip8* chip8, const uint8_t* rom, long size, int quirks)
+{
+    assert(rom != NULL);
+
+    if (CHIP8_ROM_ADDR + size > CHIP8_XO_MEM_SIZE) {
         return CHIP8_ERROR_OVERSIZED_ROM;
     }
 
-    memmove(chip8->mem + CHIP8_ROM_ADDR, rom, size);
+    // only ROMs too large for classic memory pay for the XO-CHIP 64K
+    if (CHIP8_ROM_ADDR + size >= CHIP8_MEM_SIZE && chip8->xmem == NULL) {
+        if (chip8_extend(chip8) != CHIP8_OK) return CHIP8_ERROR_ALLOC;
+    }
+
+    memmove(chip8_memory(chip8) + CHIP8_ROM_ADDR, rom, size);
     chip8->pc = CHIP8_ROM_ADDR;
+    chip8->quirks = (chip8->quirks & ~CHIP8_QUIRK_MASK) | (quirks & CHIP8_QUIRK_MASK);
+
+    // join the shared decode cache for this memory image, running uncached
+    // if it cannot be allocated
+    if (chip8->cache != NULL && chip8->xmem == NULL) cache_attach(chip8->cache, chip8->mem);
 
     return CHIP8_OK;
 }
 
 int
-chip8_step(struct chip8* chip8)
+chip8_extend(struct chip8* chip8)
 {
-    uint16_t code = chip8->mem[chip8->pc] << 8 | chip8->mem[chip8->pc + 1];
+    assert(chip8 != NULL);
+
+    if (chip8->xmem != NULL) return CHIP8_OK;
+
+    uint8_t* xmem = calloc(1, CHIP8_XO_MEM_SIZE + CHIP8_MEM_GUARD);
+    if (xmem == NULL) return CHIP8_ERROR_ALLOC;
+
+    memcpy(xmem, chip8->mem, CHIP8_MEM_SIZE);
+    memcpy(xmem + CHIP8_XO_MEM_SIZE, xmem, CHIP8_MEM_GUARD);
+    chip8->xmem = xmem;
+
+    return CHIP8_OK;
+}
+
+int
+chip8_copy(struct chip8* dst, const struct chip8* src)
+{
+    assert(dst != NULL);
+    assert(src != NULL);
+
+    // dst keeps its own extended memory, if any, so it must be initialized
+    // or zeroed. It is released when src has none so small machines stay small.
+    // dst also keeps its own decode cache view, since a view must never be
+    // shared between machines. Its entries are checked against memory, so
+    // it stays correct when memory is replaced wholesale.
+    uint8_t* xmem = dst->xmem;
+    struct cache* cache = dst->cache;
+    memcpy(dst, src, sizeof(*dst));
+    dst->xmem = xmem;
+    dst->cache = cache;
+
+    if (src->xmem == NULL) {
+        chip8_free(dst);
+        return CHIP8_OK;
+    }
 
-    struct instruction inst = { 0 };
-    int rc = instruction_decode(&inst, code);
-    if (rc != INSTRUCTION_OK) {
-        fprintf(stderr, "attempted to decode a bad instruction\n");
-        return CHIP8_ERROR_BAD_INSTRUCTION;
+    if (dst->xmem == NULL) {
+        dst->xmem = malloc(CHIP8_XO_MEM_SIZE + CHIP8_MEM_GUARD);
+        if (dst->xmem == NULL) return CHIP8_ERROR_ALLOC;
     }
+    memcpy(dst->xmem, src->xmem, CHIP8_XO_MEM_SIZE + CHIP8_MEM_GUARD);
+
+    return CHIP8_OK;
+}
+
+void
+chip8_free(struct chip8* chip8)
+{
+    assert(chip8 != NULL);
+
+    free(chip8->xmem);
+    chip8->xmem = NULL;
+}
+
+uint64_t
+chip8_hash(const struct chip8* chip8)
+{
+    assert(chip8 != NULL);
+
+    // input is left out since it is set by the host rather than the machine,
+    // the guard region since it only mirrors memory, and the cache since it
+    // never changes what the machine does
+    const uint8_t* mem = chip8->xmem != NULL ? chip8->xmem : chip8->mem;
+    uint64_t hash = HASH_BASIS;
+    hash = hash_update_wide(hash, chip8, offsetof(struct chip8, input));
+    hash = hash_update_wide(hash, &chip8->hires, offsetof(struct chip8, mem) - offsetof(struct chip8, hires));
+    hash = hash_update_wide(hash, mem, chip8_addr_mask(chip8) + 1);
+    hash = hash_update_wide(hash, chip8->display, sizeof(chip8->display));
+    return hash_finish(hash);
+}
+
+// Charge the instructions that just ran against the frame's cycle budget,
+// ending the frame once it is spent or, waiting for vblank, after a draw
+static void
+chip8_charge(struct chip8* chip8, const struct instruction* inst, long count, int opcode)
+{
+    long cycles = chip8->cycles;
+    for (long i = 0; i < count; i++) cycles += instruction_cycles(&inst[i]);
 
-    rc = operation_apply(chip8, &inst);
-    if (rc != OPERATION_OK) {
-        fprintf(stderr, "attempted to execute a bad operation: %s\n", operation_error_message(rc));
-        return CHIP8_ERROR_BAD_OPERATION;
+    bool drawn = opcode == OPCODE_DRW_Dxyn || opcode == OPCODE_DRW_Dxy0;
+    bool vblank = chip8_timing(chip8) == CHIP8_TIMING_VIP_VBLANK && drawn;
+    if (cycles < CHIP8_VIP_CYCLES_PER_FRAME && !vblank) {
+        chip8->cycles = cycles;
+        chip8->phase = 1;
+        return;
     }
 
+    // an overrun carries into the next frame, but waiting for vblank
+    // spends whatever was left of this one
+    chip8->cycles = vblank ? 0 : cycles - CHIP8_VIP_CYCLES_PER_FRAME;
     if (chip8->timer_delay > 0) chip8->timer_delay -= 1;
     if (chip8->timer_sound > 0) chip8->timer_sound -= 1;
+    chip8->phase = 0;
+}
+
+// Execute at least one and at most budget instructions, reporting how many
+// ran in count and the opcode of the last one. Without a cache this is
+// always a single plain step.
+static int
+chip8_execute(struct chip8* chip8, long budget, long* count, int* opcode)
+{
+    // the second byte at the top of memory comes from the guard region
+    const uint8_t* mem = chip8_memory(chip8);
+    chip8->pc &= chip8_addr_mask(chip8);
+    uint16_t code = mem[chip8->pc] << 8 | mem[chip8->pc + 1];
+
+    struct instruction inst[INSTRUCTION_FUSION_MAX] = {{ 0 }};
+    *count = 1;
+
+    // the cache only covers classic memory, so extended machines decode plainly
+    int rc = OPERATION_OK;
+    if (chip8->cache == NULL || chip8->xmem != NULL) {
+        if (instruction_decode(&inst[0], code) != INSTRUCTION_OK) return CHIP8_ERROR_BAD_INSTRUCTION;
+        rc = operation_apply(chip8, &inst[0]);
+        *opcode = inst[0].opcode;
+    } else {
+        const struct cache_entry* entry = cache_lookup(chip8->cache, chip8->mem, chip8->pc);
+        if (entry == NULL) return CHIP8_ERROR_BAD_INSTRUCTION;
+
+        // a fusion only runs when it fits in the budget and memory
+        // still holds the sequence it was built from
+        long length = instruction_fusion_length(entry->fusion);
+        const int* opcodes = instruction_fusion_opcodes(entry->fusion);
+        bool fused = entry->fusion != FUSION_NONE && length <= budget;
+        for (long i = 0; i < length; i++) {
+            uint16_t addr = chip8->pc + i * 2;
+            uint16_t word = chip8->mem[addr] << 8 | chip8->mem[addr + 1];
+            instruction_operands(&inst[i], word);
+            inst[i].opcode = opcodes[i];
+            if (i > 0 && !instruction_matches(word, opcodes[i])) fused = false;
+        }
+
+        // with VIP timing a fusion must also finish inside the frame, so
+        // that no instruction in it runs after the timers tick
+        if (fused && chip8_timing(chip8) != CHIP8_TIMING_STEPS) {
+            long cycles = chip8->cycles;
+            for (long i = 0; i < length; i++) cycles += instruction_cycles(&inst[i]);
+            if (cycles >= CHIP8_VIP_CYCLES_PER_FRAME) fused = false;
+        }
+
+        if (fused) {
+            rc = operation_fused(chip8, entry->fusion, inst, count);
+            *opcode = opcodes[*count - 1];
+        } else {
+            instruction_operands(&inst[0], code);
+            inst[0].opcode = entry->opcode;
+            rc = operation_apply(chip8, &inst[0]);
+            *opcode = entry->opcode;
+        }
+    }
+
+    // faults are reported to the caller rather than printed, since tools
+    // like the explorer and fuzzer expect most of the machines they run to fault
+    if (rc != OPERATION_OK) return CHIP8_ERROR_BAD_OPERATION;
 
+    if (chip8_timing(chip8) == CHIP8_TIMING_STEPS) {
+        // timers tick once for every instruction that ran
+        chip8->timer_delay = chip8->timer_delay > *count ? chip8->timer_delay - *count : 0;
+        chip8->timer_sound = chip8->timer_sound > *count ? chip8->timer_sound - *count : 0;
+
+        // callers never let a fusion run past the end of a frame
+        chip8->phase = (chip8->phase + *count) % CHIP8_STEPS_PER_FRAME;
+    } else {
+        chip8_charge(chip8, inst, *count, *opcode);
+    }
+
+    return CHIP8_OK;
+}
+
+int
+chip8_step(struct chip8* chip8)
+{
+    long count = 0;
+    int opcode = OPCODE_UNDEFINED;
+    return chip8_execute(chip8, 1, &count, &opcode);
+}
+
+int
+chip8_frame(struct chip8* chip8)
+{
+    // a frame runs up to the next frame boundary, stopping early on the first error
+    struct chip8_event event = { 0 };
+    return chip8_run_until(chip8, CHIP8_EVENT_FRAME, chip8_frame_steps(chip8), &event);
+}
+
+// The most instructions a frame can take. Every instruction costs at
+// least one cycle, so a VIP frame always ends within its cycle budget.
+long
+chip8_frame_steps(const struct chip8* chip8)
+{
+    assert(chip8 != NULL);
+
+    return chip8_timing(chip8) == CHIP8_TIMING_STEPS ? CHIP8_STEPS_PER_FRAME : CHIP8_VIP_CYCLES_PER_FRAME;
+}
+
+int
+chip8_run_until(struct chip8* chip8, int events, long budget, struct chip8_event* event)
+{
+    assert(chip8 != NULL);
+    assert(event != NULL);
+
+    memset(event, 0, sizeof(*event));
+    while (event->steps < budget) {
+        // fusions are capped so that frames end where plain steps would,
+        // and so that a selected sound stop lands on the step that caused it.
+        // VIP timing keeps fusions inside the frame by itself and only ticks
+        // the timers at the end of one.
+        long cap = budget - event->steps;
+        if (chip8_timing(chip8) == CHIP8_TIMING_STEPS) {
+            long frame_left = CHIP8_STEPS_PER_FRAME - chip8->phase;
+            if (frame_left < cap) cap = frame_left;
+            if ((events & CHIP8_EVENT_SOUND) && chip8->timer_sound > 0 && chip8->timer_sound < cap) {
+                cap = chip8->timer_sound;
+            }
+        }
+
+        uint16_t pc = chip8->pc;
+        bool sound = chip8->timer_sound > 0;
+        long count = 0;
+        int opcode = OPCODE_UNDEFINED;
+        int rc = chip8_execute(chip8, cap, &count, &opcode);
+        event->pc = chip8->pc;
+        event->sound = chip8->timer_sound > 0;
+        if (rc != CHIP8_OK) {
+            event->type = CHIP8_EVENT_FAULT;
+            event->error = rc;
+            return rc;
+        }
+        event->steps += count;
+
+        int type = 0;
+        if (chip8->phase == 0) type |= CHIP8_EVENT_FRAME;
+        if (event->sound != sound) type |= CHIP8_EVENT_SOUND;
+        if (opcode == OPCODE_LD_Fx0A && chip8->pc == pc) type |= CHIP8_EVENT_KEY_WAIT;
+        switch (opcode) {
+        case OPCODE_CLS_00E0:
+        case OPCODE_SCD_00Cn:
+        case OPCODE_SCR_00FB:
+        case OPCODE_SCL_00FC:
+        case OPCODE_LOW_00FE:
+        case OPCODE_HIGH_00FF:
+        case OPCODE_DRW_Dxy0:
+        case OPCODE_DRW_Dxyn:
+            type |= CHIP8_EVENT_DISPLAY;
+            break;
+        }
+
+        if (type & events) {
+            event->type = type & events;
+            return CHIP8_OK;
+        }
+    }
+
+    event->type = CHIP8_EVENT_BUDGET;
     return CHIP8_OK;
 }
 
+long
+chip8_display_width(const struct chip8* chip8)
+{
+    return chip8->hires ? CHIP8_DISPLAY_WIDTH : CHIP8_LORES_WIDTH;
+}
+
+long
+chip8_display_height(const struct chip8* chip8)
+{
+    return chip8->hires ? CHIP8_DISPLAY_HEIGHT : CHIP8_LORES_HEIGHT;
+}
+
 bool
 chip8_pixel_on(const struct chip8* chip8, long x, long y)
 {
-    if (x < 0 || x >= CHIP8_DISPLAY_WIDTH) return false;
-    if (y < 0 || y >= CHIP8_DISPLAY_HEIGHT) return false;
+    return chip8_pixel(chip8, x, y) != 0;
+}
+
+int
+chip8_pixel(const struct chip8* chip8, long x, long y)
+{
+    // coordinates are in the current resolution, and bit n of the
+    // result is set when the pixel is on in plane n
+    if (x < 0 || x >= chip8_display_width(chip8)) return 0;
+    if (y < 0 || y >= chip8_display_height(chip8)) return 0;
 
-    // row-major ordering
-    long index = (y * CHIP8_DISPLAY_WIDTH) + x;
-    return chip8->display[index];
+    int color = 0;
+    for (long p = 0; p < CHIP8_PLANES; p++) {
+        color |= ((chip8->display[p][y][x / 64] >> (63 - (x % 64))) & 1) << p;
+    }
+    return color;
+}
+
+uint16_t
+chip8_input_mask(const struct chip8* chip8)
+{
+    // bit n of the mask is set while key n is held
+    uint16_t mask = 0;
+    for (long i = 0; i < CHIP8_INPUT_SIZE; i++) {
+        if (chip8->input[i]) mask |= 1 << i;
+    }
+    return mask;
+}
+
+void
+chip8_set_input(struct chip8* chip8, uint16_t mask)
+{
+    for (long i = 0; i < CHIP8_INPUT_SIZE; i++) {
+        chip8->input[i] = (mask >> i) & 1;
+    }
+}
+
+const char*
+chip8_error_message(int error)
+{
+    switch (error) {
+    case CHIP8_OK: return "OK";
+    case CHIP8_ERROR_OVERSIZED_ROM: return "ROM is too large for memory";
+    case CHIP8_ERROR_BAD_INSTRUCTION: return "attempted to decode a bad instruction";
+    case CHIP8_ERROR_BAD_OPERATION: return "attempted to execute a bad operation";
+    case CHIP8_ERROR_ALLOC: return "failed to allocate memory";
+    default: return "unknown error";
+    }
 }
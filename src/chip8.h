@@ -6,16 +6,63 @@
 
 enum {
     CHIP8_MEM_SIZE = 4096,
+    CHIP8_MEM_GUARD = 32,
+    CHIP8_ADDR_MASK = CHIP8_MEM_SIZE - 1,
+    CHIP8_XO_MEM_SIZE = 65536,
+    CHIP8_XO_ADDR_MASK = CHIP8_XO_MEM_SIZE - 1,
     CHIP8_REG_SIZE = 16,
     CHIP8_STACK_SIZE = 16,
     CHIP8_INPUT_SIZE = 16,
-    CHIP8_DISPLAY_WIDTH = 64,
-    CHIP8_DISPLAY_HEIGHT = 32,
+    CHIP8_DISPLAY_WIDTH = 128,
+    CHIP8_DISPLAY_HEIGHT = 64,
+    CHIP8_DISPLAY_WORDS = CHIP8_DISPLAY_WIDTH / 64,
+    CHIP8_LORES_WIDTH = 64,
+    CHIP8_LORES_HEIGHT = 32,
+    CHIP8_PLANES = 2,
     CHIP8_REG_V0 = 0,
     CHIP8_REG_VF = 15,
     CHIP8_SPRITE_WIDTH = 8,
+    CHIP8_BIG_SPRITE_SIZE = 16,
     CHIP8_FONT_SIZE = 5,
+    CHIP8_BIG_FONT_ADDR = 16 * CHIP8_FONT_SIZE,
+    CHIP8_BIG_FONT_SIZE = 10,
+    CHIP8_RPL_SIZE = 16,
+    CHIP8_AUDIO_SIZE = 16,
     CHIP8_ROM_ADDR = 512,
+    CHIP8_STEPS_PER_FRAME = 10,
+    CHIP8_VIP_CYCLES_PER_FRAME = 3668,
+    CHIP8_CACHE_LINE = 64,
+};
+
+// Behaviors that differ between CHIP-8 interpreters, selected per ROM
+enum {
+    CHIP8_QUIRK_SHIFT_VY = 1 << 0,          // 8xy6 / 8xyE shift Vy into Vx
+    CHIP8_QUIRK_MEMORY_INCREMENT = 1 << 1,  // Fx55 / Fx65 advance I past the registers
+    CHIP8_QUIRK_LOGIC_RESET_VF = 1 << 2,    // 8xy1 / 8xy2 / 8xy3 reset VF
+    CHIP8_QUIRK_JUMP_VX = 1 << 3,           // Bnnn is read as Bxnn and jumps to xnn + Vx
+    CHIP8_QUIRK_DRAW_CLIP = 1 << 4,         // Dxyn clips sprites at the edges instead of wrapping
+    CHIP8_QUIRK_COUNT = 1 << 5,
+    CHIP8_QUIRK_MASK = CHIP8_QUIRK_COUNT - 1,
+};
+
+enum {
+    CHIP8_PROFILE_DEFAULT = 0,
+    CHIP8_PROFILE_CHIP8 = CHIP8_QUIRK_SHIFT_VY | CHIP8_QUIRK_MEMORY_INCREMENT | CHIP8_QUIRK_LOGIC_RESET_VF | CHIP8_QUIRK_DRAW_CLIP,
+    CHIP8_PROFILE_SCHIP = CHIP8_QUIRK_JUMP_VX | CHIP8_QUIRK_DRAW_CLIP,
+};
+
+// How instructions are counted against a frame. Step timing runs a fixed
+// number of instructions per frame and ticks the timers on every one. VIP
+// timing charges each instruction its COSMAC VIP cost in machine cycles
+// against a fixed budget per frame, carries any overrun into the next
+// frame and ticks the timers once per frame. VIP vblank timing also ends
+// the frame after every draw, as the VIP waited for the display interrupt.
+// The model is kept in the bits of quirks above the quirk flags.
+enum {
+    CHIP8_TIMING_STEPS = 0,
+    CHIP8_TIMING_VIP,
+    CHIP8_TIMING_VIP_VBLANK,
+    CHIP8_TIMING_SHIFT = 5,
 };
 
 enum {
@@ -23,28 +70,123 @@ enum {
     CHIP8_ERROR_OVERSIZED_ROM,
     CHIP8_ERROR_BAD_INSTRUCTION,
     CHIP8_ERROR_BAD_OPERATION,
+    CHIP8_ERROR_ALLOC,
+};
+
+// Events that chip8_run_until can stop on. Faults and running out of
+// budget always stop it, whether or not they are selected.
+enum {
+    CHIP8_EVENT_FRAME = 1 << 0,     // the last step of a frame ran
+    CHIP8_EVENT_DISPLAY = 1 << 1,   // an instruction drew to or cleared the display
+    CHIP8_EVENT_SOUND = 1 << 2,     // the sound timer started or stopped
+    CHIP8_EVENT_KEY_WAIT = 1 << 3,  // Fx0A is waiting for a key
+    CHIP8_EVENT_FAULT = 1 << 4,     // the machine faulted, see error
+    CHIP8_EVENT_BUDGET = 1 << 5,    // the budget ran out first
+};
+
+// What stopped chip8_run_until: every selected event raised by the last
+// instruction, the steps taken to get there and the pc left behind.
+struct chip8_event {
+    int type;
+    long steps;
+    uint16_t pc;
+    bool sound;
+    int error;
 };
 
+struct cache;
+
+// The hot state that every step touches is kept together at the front
+// so that it fits in a single cache line, ahead of memory and the display.
 struct chip8 {
-    uint8_t mem[CHIP8_MEM_SIZE];
     uint8_t reg[CHIP8_REG_SIZE];
 
     uint16_t index;
     uint16_t pc;
+    uint8_t sp;
+
+    uint8_t timer_delay;
+    uint8_t timer_sound;
+    uint8_t quirks;  // quirk flags, with the timing model above them
+    uint8_t planes;
+    uint8_t phase;   // steps already run in the current frame, or with VIP timing nonzero once it has begun
+    uint16_t cycles; // with VIP timing, the cycles spent in the current frame
+    uint32_t rng;
 
     uint16_t stack[CHIP8_STACK_SIZE];
-    uint16_t sp;
 
     bool input[CHIP8_INPUT_SIZE];
-    bool display[CHIP8_DISPLAY_WIDTH * CHIP8_DISPLAY_HEIGHT];
 
-    uint8_t timer_delay;
-    uint8_t timer_sound;
+    // SCHIP state: the resolution and the HP48 flag registers
+    bool hires;
+    uint8_t rpl[CHIP8_RPL_SIZE];
+
+    // XO-CHIP audio: a 1-bit pattern played back at a rate set by pitch
+    uint8_t pitch;
+    uint8_t audio[CHIP8_AUDIO_SIZE];
+
+    // I-relative accesses reach at most 31 bytes past I, and I is always
+    // masked to 12 bits, so the guard region absorbs any overrun. It mirrors
+    // the first CHIP8_MEM_GUARD bytes of memory so overruns read as a wrap.
+    // Sprites, which can reach further, mask each address instead.
+    uint8_t mem[CHIP8_MEM_SIZE + CHIP8_MEM_GUARD];
+
+    // Each row is packed into 64-bit words with the leftmost pixel in the
+    // top bit, so draws and scrolls work on whole words. Low resolution
+    // uses only the first word of the first CHIP8_LORES_HEIGHT rows.
+    // XO-CHIP adds a second bitplane, selected along with the first by planes.
+    uint64_t display[CHIP8_PLANES][CHIP8_DISPLAY_HEIGHT][CHIP8_DISPLAY_WORDS];
+
+    // optional decode cache view attached by the host after init, never
+    // shared between machines that run concurrently (the pages behind it are)
+    struct cache* cache;
+
+    // XO-CHIP 64K memory (plus guard), only allocated once a ROM needs it.
+    // While present it replaces mem entirely and addresses are 16 bits.
+    uint8_t* xmem;
 };
 
+static inline uint8_t*
+chip8_memory(struct chip8* chip8)
+{
+    return chip8->xmem != NULL ? chip8->xmem : chip8->mem;
+}
+
+static inline uint16_t
+chip8_addr_mask(const struct chip8* chip8)
+{
+    return chip8->xmem != NULL ? CHIP8_XO_ADDR_MASK : CHIP8_ADDR_MASK;
+}
+
+static inline int
+chip8_timing(const struct chip8* chip8)
+{
+    return chip8->quirks >> CHIP8_TIMING_SHIFT;
+}
+
+static inline void
+chip8_set_timing(struct chip8* chip8, int timing)
+{
+    chip8->quirks = (chip8->quirks & CHIP8_QUIRK_MASK) | timing << CHIP8_TIMING_SHIFT;
+}
+
 int chip8_init(struct chip8* chip8);
 int chip8_load(struct chip8* chip8, const uint8_t* rom, long size);
+int chip8_load_profile(struct chip8* chip8, const uint8_t* rom, long size, int quirks);
+int chip8_extend(struct chip8* chip8);
+int chip8_copy(struct chip8* dst, const struct chip8* src);
+void chip8_free(struct chip8* chip8);
+uint64_t chip8_hash(const struct chip8* chip8);
 int chip8_step(struct chip8* chip8);
+int chip8_frame(struct chip8* chip8);
+long chip8_frame_steps(const struct chip8* chip8);
+int chip8_run_until(struct chip8* chip8, int events, long budget, struct chip8_event* event);
+long chip8_display_width(const struct chip8* chip8);
+long chip8_display_height(const struct chip8* chip8);
 bool chip8_pixel_on(const struct chip8* chip8, long x, long y);
+int chip8_pixel(const struct chip8* chip8, long x, long y);
+uint16_t chip8_input_mask(const struct chip8* chip8);
+void chip8_set_input(struct chip8* chip8, uint16_t mask);
+const char* chip8_error_message(int error);
 
 #endif
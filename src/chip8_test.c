@@ -0,0 +1,132 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "chip8.c"
+
+static bool
+expect_event(struct chip8* chip8, int events, long budget, int type, long steps)
+{
+    struct chip8_event event;
+    int rc = chip8_run_until(chip8, events, budget, &event);
+    if (rc != CHIP8_OK || event.type != type || event.steps != steps) {
+        fprintf(stderr, "chip8_run_until stopped with event %d after %ld steps at %03x, wanted %d after %ld\n",
+            event.type, event.steps, event.pc, type, steps);
+        return false;
+    }
+    return true;
+}
+
+bool
+test_chip8_run_until(void)
+{
+    const uint8_t rom[] = {
+        0x60, 0x05,  // 200: LD V0, 5
+        0xf0, 0x18,  // 202: LD ST, V0
+        0xa0, 0x00,  // 204: LD I, 000
+        0xd0, 0x15,  // 206: DRW V0, V1, 5
+        0xf1, 0x0a,  // 208: LD V1, K
+        0x12, 0x0a,  // 20a: JP 20a
+        0xff, 0xff,  // 20c: bad
+    };
+
+    struct chip8 chip8 = { 0 };
+    chip8_init(&chip8);
+    chip8_load(&chip8, rom, sizeof(rom));
+
+    int events = CHIP8_EVENT_DISPLAY | CHIP8_EVENT_SOUND | CHIP8_EVENT_KEY_WAIT;
+    if (!expect_event(&chip8, events, 100, CHIP8_EVENT_SOUND, 2)) return false;
+    if (!expect_event(&chip8, events, 100, CHIP8_EVENT_DISPLAY, 2)) return false;
+    if (!expect_event(&chip8, events, 100, CHIP8_EVENT_KEY_WAIT, 1)) return false;
+
+    // the sound timer runs out on the same step that waits again
+    if (!expect_event(&chip8, events, 100, CHIP8_EVENT_SOUND | CHIP8_EVENT_KEY_WAIT, 1)) return false;
+
+    // six steps in, the frame ends four steps later
+    chip8_set_input(&chip8, 1 << 3);
+    if (!expect_event(&chip8, CHIP8_EVENT_FRAME, 100, CHIP8_EVENT_FRAME, 4)) return false;
+    if (!expect_event(&chip8, 0, 7, CHIP8_EVENT_BUDGET, 7)) return false;
+    if (chip8.reg[1] != 3) {
+        fprintf(stderr, "LD V1, K did not store the pressed key\n");
+        return false;
+    }
+
+    chip8.pc = 0x20c;
+    struct chip8_event event;
+    int rc = chip8_run_until(&chip8, 0, 100, &event);
+    if (rc != CHIP8_ERROR_BAD_INSTRUCTION || event.type != CHIP8_EVENT_FAULT || event.error != rc) {
+        fprintf(stderr, "chip8_run_until did not report the fault\n");
+        return false;
+    }
+
+    return true;
+}
+
+bool
+test_chip8_vip_timing(void)
+{
+    const uint8_t rom[] = {
+        0x60, 0x3c,  // 200: LD V0, 3C
+        0xf0, 0x15,  // 202: LD DT, V0
+        0x71, 0x01,  // 204: ADD V1, 1
+        0x12, 0x04,  // 206: JP 204
+    };
+
+    struct chip8 chip8 = { 0 };
+    chip8_init(&chip8);
+    chip8_load(&chip8, rom, sizeof(rom));
+    chip8_set_timing(&chip8, CHIP8_TIMING_VIP);
+
+    // the delay timer ticks once per frame rather than once per step
+    const long frames = 5;
+    for (long frame = 0; frame < frames; frame++) {
+        if (chip8_frame(&chip8) != CHIP8_OK || chip8.phase != 0) {
+            fprintf(stderr, "VIP frame %ld did not run to its end\n", frame);
+            return false;
+        }
+    }
+    if (chip8.timer_delay != 0x3c - frames) {
+        fprintf(stderr, "delay timer is %d after %ld VIP frames\n", chip8.timer_delay, frames);
+        return false;
+    }
+
+    // every cycle spent is accounted for by the frames run and the overrun carried
+    long adds = chip8.reg[1];
+    long jumps = chip8.pc == 0x206 ? adds - 1 : adds;
+    long spent = 46 + 46 + adds * 50 + jumps * 52;
+    if (spent != frames * CHIP8_VIP_CYCLES_PER_FRAME + chip8.cycles) {
+        fprintf(stderr, "VIP frames spent %ld cycles, wanted %ld\n",
+            spent, frames * CHIP8_VIP_CYCLES_PER_FRAME + chip8.cycles);
+        return false;
+    }
+
+    // taller sprites cost more
+    struct instruction small = { .opcode = OPCODE_DRW_Dxyn, .n = 1 };
+    struct instruction tall = { .opcode = OPCODE_DRW_Dxyn, .n = 15 };
+    if (instruction_cycles(&tall) - instruction_cycles(&small) != 14 * INSTRUCTION_CYCLES_SPRITE_BYTE) {
+        fprintf(stderr, "sprite height does not add to the cost of a draw\n");
+        return false;
+    }
+
+    // waiting for vblank, every draw ends its frame
+    const uint8_t draw[] = {
+        0xa0, 0x00,  // 200: LD I, 000
+        0xd0, 0x15,  // 202: DRW V0, V1, 5
+        0x72, 0x01,  // 204: ADD V2, 1
+        0x12, 0x02,  // 206: JP 202
+    };
+    chip8_init(&chip8);
+    chip8_load(&chip8, draw, sizeof(draw));
+    chip8_set_timing(&chip8, CHIP8_TIMING_VIP_VBLANK);
+    for (long frame = 0; frame < frames; frame++) {
+        if (!expect_event(&chip8, CHIP8_EVENT_FRAME, 1000, CHIP8_EVENT_FRAME, frame == 0 ? 2 : 3)) return false;
+        if (chip8.cycles != 0) {
+            fprintf(stderr, "a vblank draw carried %d cycles into the next frame\n", chip8.cycles);
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,341 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cache.h"
+#include "chip8.h"
+#include "explore.h"
+
+enum {
+    EXPLORE_STRIPE_CAPACITY = 1024,
+    EXPLORE_BATCH_SIZE = 64,
+};
+
+struct explore_worker {
+    struct explore* explore;
+    const struct chip8* states;
+    long count;
+    struct chip8* batch;
+    long batch_count;
+    struct cache* cache;
+    struct explore_stats stats;
+};
+
+// Insert a hash into the visited set, returning false if it was already
+// present. A stripe that cannot grow records an error and reports the
+// state as visited so that the search winds down.
+static bool
+explore_visit(struct explore* explore, uint64_t hash)
+{
+    // zero marks an empty slot, so it borrows the slot of one
+    if (hash == 0) hash = 1;
+
+    struct explore_stripe* stripe = &explore->stripes[hash % EXPLORE_STRIPES];
+    pthread_mutex_lock(&stripe->lock);
+
+    // keep each stripe at most half full
+    if ((stripe->count + 1) * 2 > stripe->capacity) {
+        long capacity = stripe->capacity * 2;
+        uint64_t* slots = calloc(capacity, sizeof(*slots));
+        if (slots == NULL) {
+            pthread_mutex_unlock(&stripe->lock);
+            pthread_mutex_lock(&explore->lock);
+            explore->error = EXPLORE_ERROR_ALLOC;
+            pthread_mutex_unlock(&explore->lock);
+            return false;
+        }
+        for (long i = 0; i < stripe->capacity; i++) {
+            uint64_t old = stripe->slots[i];
+            if (old == 0) continue;
+            long j = (old / EXPLORE_STRIPES) & (capacity - 1);
+            while (slots[j] != 0) j = (j + 1) & (capacity - 1);
+            slots[j] = old;
+        }
+        free(stripe->slots);
+        stripe->slots = slots;
+        stripe->capacity = capacity;
+    }
+
+    bool inserted = true;
+    long i = (hash / EXPLORE_STRIPES) & (stripe->capacity - 1);
+    for (;;) {
+        if (stripe->slots[i] == hash) {
+            inserted = false;
+            break;
+        }
+        if (stripe->slots[i] == 0) {
+            stripe->slots[i] = hash;
+            stripe->count += 1;
+            break;
+        }
+        i = (i + 1) & (stripe->capacity - 1);
+    }
+
+    pthread_mutex_unlock(&stripe->lock);
+    return inserted;
+}
+
+// Append states to a frontier, spilling to disk once memory is full.
+// The explore lock must be held.
+static int
+explore_append(struct explore* explore, struct explore_frontier* frontier, const struct chip8* states, long count)
+{
+    long room = explore->max_states - frontier->count;
+    long fit = count < room ? count : room;
+    memcpy(frontier->states + frontier->count, states, fit * sizeof(*states));
+    frontier->count += fit;
+
+    long rest = count - fit;
+    if (rest == 0) return EXPLORE_OK;
+
+    if (frontier->spill == NULL) {
+        frontier->spill = tmpfile();
+        if (frontier->spill == NULL) return EXPLORE_ERROR_SPILL;
+    }
+    if (fwrite(states + fit, sizeof(*states), rest, frontier->spill) != (size_t)rest) {
+        return EXPLORE_ERROR_SPILL;
+    }
+    frontier->spilled += rest;
+    explore->stats.spilled += rest;
+
+    return EXPLORE_OK;
+}
+
+static void
+explore_flush(struct explore_worker* worker)
+{
+    struct explore* explore = worker->explore;
+
+    pthread_mutex_lock(&explore->lock);
+    int rc = explore_append(explore, &explore->frontiers[1], worker->batch, worker->batch_count);
+    if (rc != EXPLORE_OK && explore->error == EXPLORE_OK) explore->error = rc;
+    pthread_mutex_unlock(&explore->lock);
+
+    worker->batch_count = 0;
+}
+
+static void*
+explore_worker(void* arg)
+{
+    struct explore_worker* worker = arg;
+
+    for (long i = 0; i < worker->count; i++) {
+        for (long key = 0; key < EXPLORE_BRANCHES; key++) {
+            struct chip8* child = &worker->batch[worker->batch_count];
+            if (chip8_copy(child, &worker->states[i]) != CHIP8_OK) {
+                worker->stats.faults += 1;
+                continue;
+            }
+            chip8_set_input(child, 1 << key);
+
+            // every clone borrows this worker's decode cache for one frame
+            child->cache = worker->cache;
+            worker->stats.frames += 1;
+            int rc = chip8_frame(child);
+            child->cache = NULL;
+
+            // a state that switched to 64K memory mid-frame cannot be moved
+            // or spilled as raw bytes, so it counts as a fault. Either way
+            // its memory is released before the slot is reused.
+            if (rc != CHIP8_OK || child->xmem != NULL) {
+                chip8_free(child);
+                worker->stats.faults += 1;
+                continue;
+            }
+
+            if (!explore_visit(worker->explore, chip8_hash(child))) {
+                worker->stats.duplicates += 1;
+                continue;
+            }
+
+            worker->stats.states += 1;
+            worker->batch_count += 1;
+            if (worker->batch_count == EXPLORE_BATCH_SIZE) explore_flush(worker);
+        }
+    }
+
+    if (worker->batch_count > 0) explore_flush(worker);
+    return NULL;
+}
+
+// Expand a chunk of the current level across all worker threads
+static int
+explore_expand(struct explore* explore, const struct chip8* states, long count)
+{
+    struct explore_worker workers[explore->num_threads];
+    pthread_t threads[explore->num_threads];
+    memset(workers, 0, sizeof(workers));
+
+    long started = 0;
+    int rc = EXPLORE_OK;
+    for (long t = 0; t < explore->num_threads; t++) {
+        long begin = count * t / explore->num_threads;
+        long end = count * (t + 1) / explore->num_threads;
+
+        workers[t].explore = explore;
+        workers[t].states = states + begin;
+        workers[t].count = end - begin;
+        workers[t].batch = calloc(EXPLORE_BATCH_SIZE, sizeof(struct chip8));
+        workers[t].cache = malloc(sizeof(struct cache));
+        if (workers[t].batch == NULL || workers[t].cache == NULL) {
+            free(workers[t].batch);
+            free(workers[t].cache);
+            rc = EXPLORE_ERROR_ALLOC;
+            break;
+        }
+
+        // every worker starts warm from the decoded start image, and just
+        // runs uncached if that cannot be allocated
+        cache_init(workers[t].cache);
+        cache_attach(workers[t].cache, explore->start->mem);
+        if (pthread_create(&threads[t], NULL, explore_worker, &workers[t]) != 0) {
+            free(workers[t].batch);
+            cache_release(workers[t].cache);
+            free(workers[t].cache);
+            rc = EXPLORE_ERROR_THREAD;
+            break;
+        }
+        started += 1;
+    }
+
+    for (long t = 0; t < started; t++) {
+        pthread_join(threads[t], NULL);
+        free(workers[t].batch);
+        cache_release(workers[t].cache);
+        free(workers[t].cache);
+
+        explore->stats.states += workers[t].stats.states;
+        explore->stats.frames += workers[t].stats.frames;
+        explore->stats.duplicates += workers[t].stats.duplicates;
+        explore->stats.faults += workers[t].stats.faults;
+    }
+
+    if (rc == EXPLORE_OK) rc = explore->error;
+    return rc;
+}
+
+int
+explore_init(struct explore* explore, long num_threads, long max_states)
+{
+    assert(explore != NULL);
+    assert(num_threads > 0);
+    assert(max_states > 0);
+
+    memset(explore, 0, sizeof(*explore));
+    explore->num_threads = num_threads;
+    explore->max_states = max_states;
+    pthread_mutex_init(&explore->lock, NULL);
+
+    for (long i = 0; i < EXPLORE_STRIPES; i++) {
+        pthread_mutex_init(&explore->stripes[i].lock, NULL);
+    }
+
+    for (long i = 0; i < EXPLORE_STRIPES; i++) {
+        struct explore_stripe* stripe = &explore->stripes[i];
+        stripe->slots = calloc(EXPLORE_STRIPE_CAPACITY, sizeof(*stripe->slots));
+        stripe->capacity = EXPLORE_STRIPE_CAPACITY;
+        if (stripe->slots == NULL) {
+            explore_free(explore);
+            return EXPLORE_ERROR_ALLOC;
+        }
+    }
+
+    for (long i = 0; i < 2; i++) {
+        explore->frontiers[i].states = calloc(max_states, sizeof(struct chip8));
+        if (explore->frontiers[i].states == NULL) {
+            explore_free(explore);
+            return EXPLORE_ERROR_ALLOC;
+        }
+    }
+
+    return EXPLORE_OK;
+}
+
+int
+explore_run(struct explore* explore, const struct chip8* start, long max_depth)
+{
+    assert(explore != NULL);
+    assert(start != NULL);
+
+    // states are moved around and spilled as raw bytes, which only works
+    // while all of memory lives inside the struct
+    if (start->xmem != NULL) return EXPLORE_ERROR_EXTENDED;
+
+    explore->start = start;
+    explore_visit(explore, chip8_hash(start));
+    explore->stats.states += 1;
+
+    struct explore_frontier* current = &explore->frontiers[0];
+    struct explore_frontier* next = &explore->frontiers[1];
+    chip8_copy(&current->states[0], start);
+    current->count = 1;
+
+    for (long depth = 0; depth < max_depth; depth++) {
+        if (current->count == 0) break;
+
+        int rc = explore_expand(explore, current->states, current->count);
+        if (rc != EXPLORE_OK) return rc;
+
+        // then stream back anything that was spilled at this level
+        if (current->spill != NULL) {
+            rewind(current->spill);
+            while (current->spilled > 0) {
+                long want = current->spilled < explore->max_states ? current->spilled : explore->max_states;
+                if (fread(current->states, sizeof(struct chip8), want, current->spill) != (size_t)want) {
+                    return EXPLORE_ERROR_SPILL;
+                }
+                current->spilled -= want;
+
+                rc = explore_expand(explore, current->states, want);
+                if (rc != EXPLORE_OK) return rc;
+            }
+            fclose(current->spill);
+            current->spill = NULL;
+        }
+
+        explore->stats.depth = depth + 1;
+
+        // the next level becomes the current one
+        struct explore_frontier done = *current;
+        done.count = 0;
+        *current = *next;
+        *next = done;
+    }
+
+    return EXPLORE_OK;
+}
+
+void
+explore_free(struct explore* explore)
+{
+    assert(explore != NULL);
+
+    for (long i = 0; i < EXPLORE_STRIPES; i++) {
+        free(explore->stripes[i].slots);
+        pthread_mutex_destroy(&explore->stripes[i].lock);
+    }
+    for (long i = 0; i < 2; i++) {
+        free(explore->frontiers[i].states);
+        if (explore->frontiers[i].spill != NULL) fclose(explore->frontiers[i].spill);
+    }
+    pthread_mutex_destroy(&explore->lock);
+
+    memset(explore, 0, sizeof(*explore));
+}
+
+const char*
+explore_error_message(int error)
+{
+    switch (error) {
+    case EXPLORE_OK: return "OK";
+    case EXPLORE_ERROR_ALLOC: return "failed to allocate memory";
+    case EXPLORE_ERROR_THREAD: return "failed to start worker thread";
+    case EXPLORE_ERROR_SPILL: return "failed to spill states to disk";
+    case EXPLORE_ERROR_EXTENDED: return "XO-CHIP extended memory is not supported";
+    default: return "unknown error";
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef SKYLARK_EXPLORE_H_INCLUDED
+#define SKYLARK_EXPLORE_H_INCLUDED
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "chip8.h"
+
+enum {
+    EXPLORE_STRIPES = 64,
+    EXPLORE_BRANCHES = CHIP8_INPUT_SIZE,
+};
+
+enum explore_status {
+    EXPLORE_OK = 0,
+    EXPLORE_ERROR_ALLOC,
+    EXPLORE_ERROR_THREAD,
+    EXPLORE_ERROR_SPILL,
+    EXPLORE_ERROR_EXTENDED,
+};
+
+// The visited set only stores 64-bit state hashes. It is split into
+// stripes, each with its own lock and open-addressed table, so that
+// workers rarely contend with one another.
+struct explore_stripe {
+    pthread_mutex_t lock;
+    uint64_t* slots;
+    long capacity;
+    long count;
+};
+
+// A frontier holds one BFS level: up to max_states in memory, with the
+// rest spilled to a temporary file.
+struct explore_frontier {
+    struct chip8* states;
+    long count;
+    FILE* spill;
+    long spilled;
+};
+
+struct explore_stats {
+    long depth;
+    long states;
+    long frames;
+    long duplicates;
+    long faults;
+    long spilled;
+};
+
+struct explore {
+    struct explore_stripe stripes[EXPLORE_STRIPES];
+    struct explore_frontier frontiers[2];
+    pthread_mutex_t lock;
+    const struct chip8* start;
+    long max_states;
+    long num_threads;
+    struct explore_stats stats;
+    int error;
+};
+
+int explore_init(struct explore* explore, long num_threads, long max_states);
+int explore_run(struct explore* explore, const struct chip8* start, long max_depth);
+void explore_free(struct explore* explore);
+const char* explore_error_message(int error);
+
+#endif
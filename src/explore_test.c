@@ -0,0 +1,68 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "explore.c"
+
+bool
+test_explore_run(void)
+{
+    // count frames with key 0 held in V1: SKNP V0, ADD V1 1, JP 0x200
+    const uint8_t rom[] = { 0xe0, 0xa1, 0x71, 0x01, 0x12, 0x00 };
+
+    struct chip8 start = { 0 };
+    chip8_init(&start);
+    chip8_load(&start, rom, sizeof(rom));
+
+    // a single in-memory state forces the second level to spill
+    struct explore explore = { 0 };
+    if (explore_init(&explore, 2, 1) != EXPLORE_OK) {
+        fprintf(stderr, "explore_init failed to allocate\n");
+        return false;
+    }
+
+    int rc = explore_run(&explore, &start, 2);
+    struct explore_stats stats = explore.stats;
+    explore_free(&explore);
+
+    if (rc != EXPLORE_OK) {
+        fprintf(stderr, "explore_run returned an error: %s\n", explore_error_message(rc));
+        return false;
+    }
+
+    // only key 0 makes a difference: the first frame without it returns to
+    // the start state, while the second frame leaves V1 at 4 or 7
+    if (stats.states != 1 + 1 + 2) {
+        fprintf(stderr, "explore_run found %ld states\n", stats.states);
+        return false;
+    }
+    if (stats.spilled == 0) {
+        fprintf(stderr, "explore_run did not spill the frontier to disk\n");
+        return false;
+    }
+
+    // with key 0 held the machine loads I past 4K, switching to 64K memory
+    const uint8_t extend[] = {
+        0xe0, 0xa1,  // 200: SKNP V0
+        0xf0, 0x00,  // 202: LD I, 2000
+        0x20, 0x00,
+        0x12, 0x00,  // 206: JP 200
+    };
+    chip8_init(&start);
+    chip8_load(&start, extend, sizeof(extend));
+    if (explore_init(&explore, 1, 16) != EXPLORE_OK) {
+        fprintf(stderr, "explore_init failed to allocate\n");
+        return false;
+    }
+    rc = explore_run(&explore, &start, 2);
+    stats = explore.stats;
+    explore_free(&explore);
+    if (rc != EXPLORE_OK || stats.faults == 0) {
+        fprintf(stderr, "explore_run kept a state with 64K memory\n");
+        return false;
+    }
+
+    return true;
+}
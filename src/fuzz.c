@@ -0,0 +1,246 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cache.h"
+#include "chip8.h"
+#include "fuzz.h"
+#include "inst.h"
+
+// xorshift64, which never leaves a nonzero state
+static uint64_t
+fuzz_random(struct fuzz* fuzz)
+{
+    uint64_t rng = fuzz->rng;
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    fuzz->rng = rng;
+    return rng;
+}
+
+// Random words mostly decode as nothing, so retry a few times to bias
+// generated code towards instructions that actually run
+static uint16_t
+fuzz_word(struct fuzz* fuzz)
+{
+    uint16_t word = 0;
+    for (long i = 0; i < 4; i++) {
+        word = fuzz_random(fuzz);
+        struct instruction inst = { 0 };
+        if (instruction_decode(&inst, word) == INSTRUCTION_OK) break;
+    }
+    return word;
+}
+
+// Set a bit in a coverage map, returning true if it was not already set
+static bool
+fuzz_cover(uint8_t* map, long bit)
+{
+    uint8_t mask = 1 << (bit % 8);
+    if (map[bit / 8] & mask) return false;
+    map[bit / 8] |= mask;
+    return true;
+}
+
+// Check the invariants that the core should hold no matter what it runs
+static int
+fuzz_check(const struct chip8* chip8)
+{
+    // the guard must still mirror the start of memory
+    const uint8_t* mem = chip8->xmem != NULL ? chip8->xmem : chip8->mem;
+    long size = chip8_addr_mask(chip8) + 1;
+    if (memcmp(mem + size, mem, CHIP8_MEM_GUARD) != 0) return FUZZ_ERROR_GUARD;
+
+    if (chip8->sp >= CHIP8_STACK_SIZE) return FUZZ_ERROR_STACK;
+    for (long i = 0; i < chip8->sp; i++) {
+        if (chip8->stack[i] >= size) return FUZZ_ERROR_STACK;
+    }
+
+    return FUZZ_OK;
+}
+
+int
+fuzz_init(struct fuzz* fuzz, uint64_t seed)
+{
+    assert(fuzz != NULL);
+
+    memset(fuzz, 0, sizeof(*fuzz));
+    fuzz->rng = seed != 0 ? seed : 1;
+
+    fuzz->corpus = calloc(FUZZ_CORPUS_SIZE, sizeof(*fuzz->corpus));
+    if (fuzz->corpus == NULL) return FUZZ_ERROR_ALLOC;
+
+    // every case starts from the same seed so findings can be replayed
+    chip8_init(&fuzz->base);
+    fuzz->base.rng = 1;
+
+    // the cache is attached to the base image once, and each case then
+    // loads over it the way a self-modifying ROM would
+    cache_init(&fuzz->cache);
+    cache_attach(&fuzz->cache, fuzz->base.mem);
+
+    return FUZZ_OK;
+}
+
+void
+fuzz_next(struct fuzz* fuzz, struct fuzz_case* fc)
+{
+    assert(fuzz != NULL);
+    assert(fc != NULL);
+
+    // now and then start over from scratch rather than from the corpus
+    if (fuzz->corpus_count == 0 || fuzz_random(fuzz) % 8 == 0) {
+        memset(fc, 0, sizeof(*fc));
+        fc->size = 2 + fuzz_random(fuzz) % (FUZZ_ROM_SIZE / 2) * 2;
+        for (long i = 0; i < fc->size; i += 2) {
+            uint16_t word = fuzz_word(fuzz);
+            fc->rom[i] = word >> 8;
+            fc->rom[i + 1] = word & 0xff;
+        }
+        for (long i = 0; i < FUZZ_FRAMES; i++) {
+            fc->inputs[i] = fuzz_random(fuzz) % 4 == 0 ? 1 << fuzz_random(fuzz) % CHIP8_INPUT_SIZE : 0;
+        }
+        return;
+    }
+
+    *fc = fuzz->corpus[fuzz_random(fuzz) % fuzz->corpus_count];
+
+    long mutations = 1 + fuzz_random(fuzz) % FUZZ_MUTATIONS_MAX;
+    for (long m = 0; m < mutations; m++) {
+        long at = fuzz_random(fuzz) % fc->size;
+        switch (fuzz_random(fuzz) % 5) {
+        case 0:
+            fc->rom[at] ^= 1 << fuzz_random(fuzz) % 8;
+            break;
+        case 1:
+            fc->rom[at] = fuzz_random(fuzz);
+            break;
+        case 2: {
+            uint16_t word = fuzz_word(fuzz);
+            at &= ~1L;
+            fc->rom[at] = word >> 8;
+            if (at + 1 < fc->size) fc->rom[at + 1] = word & 0xff;
+            break;
+        }
+        case 3:
+            fc->inputs[fuzz_random(fuzz) % FUZZ_FRAMES] = fuzz_random(fuzz);
+            break;
+        case 4: {
+            long from = fuzz_random(fuzz) % fc->size;
+            long length = 2 + fuzz_random(fuzz) % 15;
+            if (from + length > fc->size) length = fc->size - from;
+            if (at + length > fc->size) length = fc->size - at;
+            memmove(fc->rom + at, fc->rom + from, length);
+            break;
+        }
+        }
+    }
+}
+
+int
+fuzz_run(struct fuzz* fuzz, const struct fuzz_case* fc)
+{
+    assert(fuzz != NULL);
+    assert(fc != NULL);
+
+    struct chip8* plain = &fuzz->plain;
+    struct chip8* cached = &fuzz->cached;
+
+    // reset both machines from the snapshot, loading the cached one by
+    // hand so that its cache is invalidated rather than rebuilt
+    if (chip8_copy(plain, &fuzz->base) != CHIP8_OK) return FUZZ_ERROR_ALLOC;
+    if (chip8_load(plain, fc->rom, fc->size) != CHIP8_OK) return FUZZ_ERROR_ALLOC;
+    if (chip8_copy(cached, plain) != CHIP8_OK) return FUZZ_ERROR_ALLOC;
+    cached->cache = &fuzz->cache;
+    cache_invalidate(&fuzz->cache, CHIP8_ROM_ADDR, fc->size);
+
+    fuzz->stats.cases += 1;
+
+    bool interesting = false;
+    int previous = OPCODE_UNDEFINED;
+    int rc = CHIP8_OK;
+    for (long frame = 0; frame < FUZZ_FRAMES && rc == CHIP8_OK; frame++) {
+        chip8_set_input(plain, fc->inputs[frame]);
+        chip8_set_input(cached, fc->inputs[frame]);
+
+        // the plain machine steps one instruction at a time, recording
+        // coverage as it goes
+        for (long step = 0; step < CHIP8_STEPS_PER_FRAME && rc == CHIP8_OK; step++) {
+            const uint8_t* mem = chip8_memory(plain);
+            long pc = plain->pc & chip8_addr_mask(plain);
+            struct instruction inst = { 0 };
+            instruction_decode(&inst, mem[pc] << 8 | mem[pc + 1]);
+
+            if (fuzz_cover(fuzz->pcs, pc)) {
+                fuzz->stats.pcs += 1;
+                interesting = true;
+            }
+            if (!fuzz->opcodes[inst.opcode]) {
+                fuzz->opcodes[inst.opcode] = true;
+                fuzz->stats.opcodes += 1;
+                interesting = true;
+            }
+            if (fuzz_cover(fuzz->pairs, previous * OPCODE_COUNT + inst.opcode)) {
+                fuzz->stats.pairs += 1;
+                interesting = true;
+            }
+            previous = inst.opcode;
+
+            rc = chip8_step(plain);
+            fuzz->stats.steps += 1;
+        }
+
+        // the cached machine must end the frame exactly where plain steps did
+        int cached_rc = chip8_frame(cached);
+        if (cached_rc != rc || memcmp(plain, cached, offsetof(struct chip8, input)) != 0) {
+            return FUZZ_ERROR_DIVERGED;
+        }
+
+        int check = fuzz_check(plain);
+        if (check == FUZZ_OK) check = fuzz_check(cached);
+        if (check != FUZZ_OK) return check;
+    }
+
+    if (rc != CHIP8_OK) fuzz->stats.faults += 1;
+
+    // the cheap per-frame comparison only covers the hot state
+    if (chip8_hash(plain) != chip8_hash(cached)) return FUZZ_ERROR_DIVERGED;
+
+    if (interesting) {
+        fuzz->corpus[fuzz->corpus_next] = *fc;
+        fuzz->corpus_next = (fuzz->corpus_next + 1) % FUZZ_CORPUS_SIZE;
+        if (fuzz->corpus_count < FUZZ_CORPUS_SIZE) fuzz->corpus_count += 1;
+    }
+
+    return FUZZ_OK;
+}
+
+void
+fuzz_free(struct fuzz* fuzz)
+{
+    assert(fuzz != NULL);
+
+    chip8_free(&fuzz->base);
+    chip8_free(&fuzz->plain);
+    chip8_free(&fuzz->cached);
+    cache_release(&fuzz->cache);
+    free(fuzz->corpus);
+    fuzz->corpus = NULL;
+}
+
+const char*
+fuzz_error_message(int error)
+{
+    switch (error) {
+    case FUZZ_OK: return "OK";
+    case FUZZ_ERROR_ALLOC: return "failed to allocate memory";
+    case FUZZ_ERROR_GUARD: return "memory guard no longer mirrors memory";
+    case FUZZ_ERROR_STACK: return "stack pointer or return address out of range";
+    case FUZZ_ERROR_DIVERGED: return "cached engine diverged from plain steps";
+    default: return "unknown error";
+    }
+}
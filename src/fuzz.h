@@ -0,0 +1,72 @@
+#ifndef SKYLARK_FUZZ_H_INCLUDED
+#define SKYLARK_FUZZ_H_INCLUDED
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cache.h"
+#include "chip8.h"
+#include "inst.h"
+
+enum {
+    FUZZ_ROM_SIZE = 256,
+    FUZZ_FRAMES = 16,
+    FUZZ_CORPUS_SIZE = 1024,
+    FUZZ_MUTATIONS_MAX = 4,
+};
+
+// Anything other than FUZZ_OK from fuzz_run is a finding. Faults the
+// machine reports itself (bad instructions, stack overflow) are expected
+// and are only counted.
+enum fuzz_status {
+    FUZZ_OK = 0,
+    FUZZ_ERROR_ALLOC,
+    FUZZ_ERROR_GUARD,
+    FUZZ_ERROR_STACK,
+    FUZZ_ERROR_DIVERGED,
+};
+
+// A case is a ROM plus the keypad mask held down for each frame
+struct fuzz_case {
+    uint8_t rom[FUZZ_ROM_SIZE];
+    long size;
+    uint16_t inputs[FUZZ_FRAMES];
+};
+
+struct fuzz_stats {
+    long cases;
+    long steps;
+    long faults;
+    long pcs;
+    long opcodes;
+    long pairs;
+};
+
+// Every case starts from a copy of the base snapshot rather than a fresh
+// init, and runs on two machines: one stepping plainly and one running
+// whole frames through a decode cache that is reused across cases. Cases
+// that reach new PCs, opcodes or opcode pairs are kept for mutation.
+struct fuzz {
+    struct chip8 base;
+    struct chip8 plain;
+    struct chip8 cached;
+    struct cache cache;
+    uint64_t rng;
+
+    struct fuzz_case* corpus;
+    long corpus_count;
+    long corpus_next;
+
+    uint8_t pcs[CHIP8_XO_MEM_SIZE / 8];
+    uint8_t pairs[OPCODE_COUNT * OPCODE_COUNT / 8 + 1];
+    bool opcodes[OPCODE_COUNT];
+    struct fuzz_stats stats;
+};
+
+int fuzz_init(struct fuzz* fuzz, uint64_t seed);
+void fuzz_next(struct fuzz* fuzz, struct fuzz_case* fc);
+int fuzz_run(struct fuzz* fuzz, const struct fuzz_case* fc);
+void fuzz_free(struct fuzz* fuzz);
+const char* fuzz_error_message(int error);
+
+#endif
@@ -0,0 +1,39 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fuzz.c"
+
+bool
+test_fuzz_run(void)
+{
+    struct fuzz* fuzz = malloc(sizeof(*fuzz));
+    if (fuzz == NULL || fuzz_init(fuzz, 1) != FUZZ_OK) {
+        fprintf(stderr, "failed to init fuzzer\n");
+        free(fuzz);
+        return false;
+    }
+
+    bool ok = true;
+    struct fuzz_case fc;
+    for (long i = 0; i < 2000 && ok; i++) {
+        fuzz_next(fuzz, &fc);
+        int rc = fuzz_run(fuzz, &fc);
+        if (rc != FUZZ_OK) {
+            fprintf(stderr, "fuzz case %ld failed: %s\n", i, fuzz_error_message(rc));
+            ok = false;
+        }
+    }
+
+    // random code should reach a good spread of opcodes and grow a corpus
+    if (ok && (fuzz->stats.opcodes < OPCODE_COUNT / 2 || fuzz->corpus_count == 0)) {
+        fprintf(stderr, "fuzzer only covered %ld opcodes\n", fuzz->stats.opcodes);
+        ok = false;
+    }
+
+    fuzz_free(fuzz);
+    free(fuzz);
+    return ok;
+}
@@ -0,0 +1,76 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+
+#define HASH_PRIME UINT64_C(0x00000100000001b3)
+
+// XXH64 primes, used by the wide hash
+#define HASH_WIDE_PRIME_1 UINT64_C(0x9e3779b185ebca87)
+#define HASH_WIDE_PRIME_2 UINT64_C(0xc2b2ae3d27d4eb4f)
+#define HASH_WIDE_PRIME_4 UINT64_C(0x85ebca77c2b2ae63)
+
+static uint64_t
+hash_rotl(uint64_t x, int r)
+{
+    return x << r | x >> (64 - r);
+}
+
+uint64_t
+hash_bytes(const void* data, long size)
+{
+    return hash_update(HASH_BASIS, data, size);
+}
+
+uint64_t
+hash_update(uint64_t hash, const void* data, long size)
+{
+    assert(data != NULL || size == 0);
+
+    // FNV-1a: xor in each byte and then multiply by the prime
+    const uint8_t* bytes = data;
+    for (long i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= HASH_PRIME;
+    }
+
+    return hash;
+}
+
+// Consumes eight bytes at a time, which is much faster for large inputs
+// such as whole machine states. Each word is mixed on its own before it is
+// folded in, the way XXH64 consumes its tail, so that every bit of it
+// reaches every bit of the hash. Its output differs from hash_update.
+uint64_t
+hash_update_wide(uint64_t hash, const void* data, long size)
+{
+    assert(data != NULL || size == 0);
+
+    const uint8_t* bytes = data;
+    long i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word = 0;
+        memcpy(&word, bytes + i, sizeof(word));
+        word *= HASH_WIDE_PRIME_2;
+        word = hash_rotl(word, 31);
+        word *= HASH_WIDE_PRIME_1;
+        hash ^= word;
+        hash = hash_rotl(hash, 27) * HASH_WIDE_PRIME_1 + HASH_WIDE_PRIME_4;
+    }
+
+    return hash_update(hash, bytes + i, size - i);
+}
+
+uint64_t
+hash_finish(uint64_t hash)
+{
+    // final avalanche from MurmurHash3 so that high bits depend on every input bit
+    hash ^= hash >> 33;
+    hash *= UINT64_C(0xff51afd7ed558ccd);
+    hash ^= hash >> 33;
+    hash *= UINT64_C(0xc4ceb9fe1a85ec53);
+    hash ^= hash >> 33;
+    return hash;
+}
@@ -0,0 +1,14 @@
+#ifndef SKYLARK_HASH_H_INCLUDED
+#define SKYLARK_HASH_H_INCLUDED
+
+#include <stdint.h>
+
+// 64-bit FNV-1a offset basis, used to start a new hash
+#define HASH_BASIS UINT64_C(0xcbf29ce484222325)
+
+uint64_t hash_bytes(const void* data, long size);
+uint64_t hash_update(uint64_t hash, const void* data, long size);
+uint64_t hash_update_wide(uint64_t hash, const void* data, long size);
+uint64_t hash_finish(uint64_t hash);
+
+#endif
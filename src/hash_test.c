@@ -0,0 +1,40 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.c"
+
+bool
+test_hash_wide(void)
+{
+    // flipping the top bit of two words must not cancel out
+    uint64_t words[16] = { 0 };
+    uint64_t blank = hash_finish(hash_update_wide(HASH_BASIS, words, sizeof(words)));
+    for (long a = 0; a < 16; a++) {
+        for (long b = a + 1; b < 16; b++) {
+            memset(words, 0, sizeof(words));
+            words[a] = words[b] = UINT64_C(1) << 63;
+            if (hash_finish(hash_update_wide(HASH_BASIS, words, sizeof(words))) == blank) {
+                fprintf(stderr, "flipping the top bit of words %ld and %ld leaves the hash unchanged\n", a, b);
+                return false;
+            }
+        }
+    }
+
+    // the same for two leftmost pixels of the display
+    struct chip8 a = { 0 };
+    struct chip8 b = { 0 };
+    chip8_init(&a);
+    chip8_init(&b);
+    a.rng = b.rng = 1;
+    b.display[0][3][0] = b.display[0][9][0] = UINT64_C(1) << 63;
+    if (chip8_hash(&a) == chip8_hash(&b)) {
+        fprintf(stderr, "chip8_hash matches for different displays\n");
+        return false;
+    }
+
+    return true;
+}
@@ -1,5 +1,7 @@
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "inst.h"
 
@@ -10,12 +12,20 @@ static const struct {
     [OPCODE_UNDEFINED] = { 0, 0 },
     [OPCODE_CLS_00E0]  = { 0xffff, 0x00E0 },
     [OPCODE_RET_00EE]  = { 0xffff, 0x00EE },
+    [OPCODE_SCD_00Cn]  = { 0xfff0, 0x00C0 },
+    [OPCODE_SCR_00FB]  = { 0xffff, 0x00FB },
+    [OPCODE_SCL_00FC]  = { 0xffff, 0x00FC },
+    [OPCODE_EXIT_00FD] = { 0xffff, 0x00FD },
+    [OPCODE_LOW_00FE]  = { 0xffff, 0x00FE },
+    [OPCODE_HIGH_00FF] = { 0xffff, 0x00FF },
     [OPCODE_SYS_0nnn]  = { 0xf000, 0x0000 },
     [OPCODE_JP_1nnn]   = { 0xf000, 0x1000 },
     [OPCODE_CALL_2nnn] = { 0xf000, 0x2000 },
     [OPCODE_SE_3xkk]   = { 0xf000, 0x3000 },
     [OPCODE_SNE_4xkk]  = { 0xf000, 0x4000 },
     [OPCODE_SE_5xy0]   = { 0xf00f, 0x5000 },
+    [OPCODE_LD_5xy2]   = { 0xf00f, 0x5002 },
+    [OPCODE_LD_5xy3]   = { 0xf00f, 0x5003 },
     [OPCODE_LD_6xkk]   = { 0xf000, 0x6000 },
     [OPCODE_ADD_7xkk]  = { 0xf000, 0x7000 },
     [OPCODE_LD_8xy0]   = { 0xf00f, 0x8000 },
@@ -31,30 +41,46 @@ static const struct {
     [OPCODE_LD_Annn]   = { 0xf000, 0xA000 },
     [OPCODE_JP_Bnnn]   = { 0xf000, 0xB000 },
     [OPCODE_RND_Cxkk]  = { 0xf000, 0xC000 },
+    [OPCODE_DRW_Dxy0]  = { 0xf00f, 0xD000 },
     [OPCODE_DRW_Dxyn]  = { 0xf000, 0xD000 },
     [OPCODE_SKP_Ex9E]  = { 0xf0ff, 0xE09E },
     [OPCODE_SKNP_ExA1] = { 0xf0ff, 0xE0A1 },
+    [OPCODE_LD_F000]   = { 0xffff, 0xF000 },
+    [OPCODE_PLANE_Fn01] = { 0xf0ff, 0xF001 },
+    [OPCODE_AUDIO_F002] = { 0xffff, 0xF002 },
     [OPCODE_LD_Fx07]   = { 0xf0ff, 0xF007 },
     [OPCODE_LD_Fx0A]   = { 0xf0ff, 0xF00A },
     [OPCODE_LD_Fx15]   = { 0xf0ff, 0xF015 },
     [OPCODE_LD_Fx18]   = { 0xf0ff, 0xF018 },
     [OPCODE_ADD_Fx1E]  = { 0xf0ff, 0xF01E },
     [OPCODE_LD_Fx29]   = { 0xf0ff, 0xF029 },
+    [OPCODE_LD_Fx30]   = { 0xf0ff, 0xF030 },
     [OPCODE_LD_Fx33]   = { 0xf0ff, 0xF033 },
+    [OPCODE_LD_Fx3A]   = { 0xf0ff, 0xF03A },
     [OPCODE_LD_Fx55]   = { 0xf0ff, 0xF055 },
     [OPCODE_LD_Fx65]   = { 0xf0ff, 0xF065 },
+    [OPCODE_LD_Fx75]   = { 0xf0ff, 0xF075 },
+    [OPCODE_LD_Fx85]   = { 0xf0ff, 0xF085 },
 };
 
 static const char* INSTRUCTION_NAMES[] = {
     [OPCODE_UNDEFINED] = "OPCODE_UNDEFINED",
     [OPCODE_CLS_00E0]  = "OPCODE_CLS_00E0", 
     [OPCODE_RET_00EE]  = "OPCODE_RET_00EE", 
+    [OPCODE_SCD_00Cn]  = "OPCODE_SCD_00Cn", 
+    [OPCODE_SCR_00FB]  = "OPCODE_SCR_00FB", 
+    [OPCODE_SCL_00FC]  = "OPCODE_SCL_00FC", 
+    [OPCODE_EXIT_00FD] = "OPCODE_EXIT_00FD", 
+    [OPCODE_LOW_00FE]  = "OPCODE_LOW_00FE", 
+    [OPCODE_HIGH_00FF] = "OPCODE_HIGH_00FF", 
     [OPCODE_SYS_0nnn]  = "OPCODE_SYS_0nnn", 
     [OPCODE_JP_1nnn]   = "OPCODE_JP_1nnn", 
     [OPCODE_CALL_2nnn] = "OPCODE_CALL_2nnn", 
     [OPCODE_SE_3xkk]   = "OPCODE_SE_3xkk", 
     [OPCODE_SNE_4xkk]  = "OPCODE_SNE_4xkk", 
     [OPCODE_SE_5xy0]   = "OPCODE_SE_5xy0", 
+    [OPCODE_LD_5xy2]   = "OPCODE_LD_5xy2", 
+    [OPCODE_LD_5xy3]   = "OPCODE_LD_5xy3", 
     [OPCODE_LD_6xkk]   = "OPCODE_LD_6xkk", 
     [OPCODE_ADD_7xkk]  = "OPCODE_ADD_7xkk", 
     [OPCODE_LD_8xy0]   = "OPCODE_LD_8xy0", 
@@ -70,30 +96,102 @@ static const char* INSTRUCTION_NAMES[] = {
     [OPCODE_LD_Annn]   = "OPCODE_LD_Annn", 
     [OPCODE_JP_Bnnn]   = "OPCODE_JP_Bnnn", 
     [OPCODE_RND_Cxkk]  = "OPCODE_RND_Cxkk", 
+    [OPCODE_DRW_Dxy0]  = "OPCODE_DRW_Dxy0", 
     [OPCODE_DRW_Dxyn]  = "OPCODE_DRW_Dxyn", 
     [OPCODE_SKP_Ex9E]  = "OPCODE_SKP_Ex9E", 
     [OPCODE_SKNP_ExA1] = "OPCODE_SKNP_ExA1", 
+    [OPCODE_LD_F000]   = "OPCODE_LD_F000", 
+    [OPCODE_PLANE_Fn01] = "OPCODE_PLANE_Fn01", 
+    [OPCODE_AUDIO_F002] = "OPCODE_AUDIO_F002", 
     [OPCODE_LD_Fx07]   = "OPCODE_LD_Fx07", 
     [OPCODE_LD_Fx0A]   = "OPCODE_LD_Fx0A", 
     [OPCODE_LD_Fx15]   = "OPCODE_LD_Fx15", 
     [OPCODE_LD_Fx18]   = "OPCODE_LD_Fx18", 
     [OPCODE_ADD_Fx1E]  = "OPCODE_ADD_Fx1E", 
     [OPCODE_LD_Fx29]   = "OPCODE_LD_Fx29", 
+    [OPCODE_LD_Fx30]   = "OPCODE_LD_Fx30", 
     [OPCODE_LD_Fx33]   = "OPCODE_LD_Fx33", 
+    [OPCODE_LD_Fx3A]   = "OPCODE_LD_Fx3A", 
     [OPCODE_LD_Fx55]   = "OPCODE_LD_Fx55", 
     [OPCODE_LD_Fx65]   = "OPCODE_LD_Fx65", 
+    [OPCODE_LD_Fx75]   = "OPCODE_LD_Fx75", 
+    [OPCODE_LD_Fx85]   = "OPCODE_LD_Fx85", 
+};
+
+// Approximate costs on the COSMAC VIP in machine cycles, including the
+// interpreter's fetch and decode. Sprites and register ranges add a cost
+// per byte or register on top. SUPER-CHIP and XO-CHIP instructions never
+// ran on the VIP and are costed like their nearest relatives.
+static const uint16_t INSTRUCTION_CYCLES[] = {
+    [OPCODE_UNDEFINED] = 0,
+    [OPCODE_CLS_00E0]  = 3078,
+    [OPCODE_RET_00EE]  = 50,
+    [OPCODE_SCD_00Cn]  = 3078,
+    [OPCODE_SCR_00FB]  = 3078,
+    [OPCODE_SCL_00FC]  = 3078,
+    [OPCODE_EXIT_00FD] = 40,
+    [OPCODE_LOW_00FE]  = 50,
+    [OPCODE_HIGH_00FF] = 50,
+    [OPCODE_SYS_0nnn]  = 52,
+    [OPCODE_JP_1nnn]   = 52,
+    [OPCODE_CALL_2nnn] = 66,
+    [OPCODE_SE_3xkk]   = 50,
+    [OPCODE_SNE_4xkk]  = 50,
+    [OPCODE_SE_5xy0]   = 54,
+    [OPCODE_LD_5xy2]   = 54,
+    [OPCODE_LD_5xy3]   = 54,
+    [OPCODE_LD_6xkk]   = 46,
+    [OPCODE_ADD_7xkk]  = 50,
+    [OPCODE_LD_8xy0]   = 52,
+    [OPCODE_OR_8xy1]   = 60,
+    [OPCODE_AND_8xy2]  = 60,
+    [OPCODE_XOR_8xy3]  = 60,
+    [OPCODE_ADD_8xy4]  = 60,
+    [OPCODE_SUB_8xy5]  = 60,
+    [OPCODE_SHR_8xy6]  = 60,
+    [OPCODE_SUBN_8xy7] = 60,
+    [OPCODE_SHL_8xyE]  = 60,
+    [OPCODE_SNE_9xy0]  = 54,
+    [OPCODE_LD_Annn]   = 52,
+    [OPCODE_JP_Bnnn]   = 62,
+    [OPCODE_RND_Cxkk]  = 76,
+    [OPCODE_DRW_Dxy0]  = 66,
+    [OPCODE_DRW_Dxyn]  = 66,
+    [OPCODE_SKP_Ex9E]  = 54,
+    [OPCODE_SKNP_ExA1] = 54,
+    [OPCODE_LD_F000]   = 64,
+    [OPCODE_PLANE_Fn01] = 46,
+    [OPCODE_AUDIO_F002] = 270,
+    [OPCODE_LD_Fx07]   = 46,
+    [OPCODE_LD_Fx0A]   = 52,
+    [OPCODE_LD_Fx15]   = 46,
+    [OPCODE_LD_Fx18]   = 46,
+    [OPCODE_ADD_Fx1E]  = 52,
+    [OPCODE_LD_Fx29]   = 56,
+    [OPCODE_LD_Fx30]   = 56,
+    [OPCODE_LD_Fx33]   = 124,
+    [OPCODE_LD_Fx3A]   = 46,
+    [OPCODE_LD_Fx55]   = 54,
+    [OPCODE_LD_Fx65]   = 54,
+    [OPCODE_LD_Fx75]   = 54,
+    [OPCODE_LD_Fx85]   = 54,
+};
+
+static const struct {
+    long length;
+    int opcodes[INSTRUCTION_FUSION_MAX];
+} INSTRUCTION_FUSIONS[] = {
+    [FUSION_NONE]                     = { 1, { OPCODE_UNDEFINED }},
+    [FUSION_LD_Annn_DRW_Dxyn]         = { 2, { OPCODE_LD_Annn, OPCODE_DRW_Dxyn }},
+    [FUSION_ADD_7xkk_SE_3xkk_JP_1nnn] = { 3, { OPCODE_ADD_7xkk, OPCODE_SE_3xkk, OPCODE_JP_1nnn }},
+    [FUSION_LD_Fx07_SE_3xkk]          = { 2, { OPCODE_LD_Fx07, OPCODE_SE_3xkk }},
 };
 
 int
 instruction_decode(struct instruction* inst, uint16_t code)
 {
     // params can be set now since their position is consistent
-    inst->opcode = OPCODE_UNDEFINED;
-    inst->nnn = code & 0x0fff;
-    inst->n = code & 0x000f;
-    inst->x = (code & 0x0f00) >> 8;
-    inst->y = (code & 0x00f0) >> 4;
-    inst->kk = code & 0x00ff;
+    instruction_operands(inst, code);
 
     // loop through each opcode and try to find a match
     for (int op = OPCODE_UNDEFINED + 1; op < OPCODE_COUNT; op++) {
@@ -108,6 +206,32 @@ instruction_decode(struct instruction* inst, uint16_t code)
     return INSTRUCTION_ERROR;
 }
 
+void
+instruction_operands(struct instruction* inst, uint16_t code)
+{
+    inst->opcode = OPCODE_UNDEFINED;
+    inst->nnn = code & 0x0fff;
+    inst->n = code & 0x000f;
+    inst->x = (code & 0x0f00) >> 8;
+    inst->y = (code & 0x00f0) >> 4;
+    inst->kk = code & 0x00ff;
+}
+
+bool
+instruction_matches(uint16_t code, int opcode)
+{
+    if ((code & INSTRUCTION_MASKS[opcode].mask) != INSTRUCTION_MASKS[opcode].value) return false;
+
+    // opcodes are grouped by their top nibble, and within a group an earlier
+    // opcode wins (Dxy0 over Dxyn, for example), so check those as well
+    for (int op = opcode - 1; op > OPCODE_UNDEFINED; op--) {
+        if ((INSTRUCTION_MASKS[op].value ^ code) & 0xf000) break;
+        if ((code & INSTRUCTION_MASKS[op].mask) == INSTRUCTION_MASKS[op].value) return false;
+    }
+
+    return true;
+}
+
 const char*
 instruction_name(const struct instruction* inst)
 {
@@ -117,3 +241,62 @@ instruction_name(const struct instruction* inst)
 
     return INSTRUCTION_NAMES[inst->opcode];
 }
+
+long
+instruction_cycles(const struct instruction* inst)
+{
+    if (inst->opcode <= OPCODE_UNDEFINED || inst->opcode >= OPCODE_COUNT) return 0;
+
+    long cycles = INSTRUCTION_CYCLES[inst->opcode];
+    switch (inst->opcode) {
+    case OPCODE_DRW_Dxyn:
+        cycles += inst->n * INSTRUCTION_CYCLES_SPRITE_BYTE;
+        break;
+    case OPCODE_DRW_Dxy0:
+        // 16 rows of two bytes each
+        cycles += 32 * INSTRUCTION_CYCLES_SPRITE_BYTE;
+        break;
+    case OPCODE_LD_5xy2:
+    case OPCODE_LD_5xy3:
+        cycles += (abs(inst->x - inst->y) + 1) * INSTRUCTION_CYCLES_REGISTER;
+        break;
+    case OPCODE_LD_Fx55:
+    case OPCODE_LD_Fx65:
+    case OPCODE_LD_Fx75:
+    case OPCODE_LD_Fx85:
+        cycles += (inst->x + 1) * INSTRUCTION_CYCLES_REGISTER;
+        break;
+    }
+    return cycles;
+}
+
+int
+instruction_fuse(const int* opcodes, long count)
+{
+    // prefer the longest fusion that matches the start of the sequence
+    int best = FUSION_NONE;
+    for (int fusion = FUSION_NONE + 1; fusion < FUSION_COUNT; fusion++) {
+        long length = INSTRUCTION_FUSIONS[fusion].length;
+        if (length > count || length <= INSTRUCTION_FUSIONS[best].length) continue;
+
+        bool match = true;
+        for (long i = 0; i < length; i++) {
+            if (opcodes[i] != INSTRUCTION_FUSIONS[fusion].opcodes[i]) match = false;
+        }
+        if (match) best = fusion;
+    }
+
+    return best;
+}
+
+long
+instruction_fusion_length(int fusion)
+{
+    return INSTRUCTION_FUSIONS[fusion].length;
+}
+
+const int*
+instruction_fusion_opcodes(int fusion)
+{
+    return INSTRUCTION_FUSIONS[fusion].opcodes;
+}
@@ -1,18 +1,27 @@
 #ifndef SKYLARK_INST_H_INCLUDED
 #define SKYLARK_INST_H_INCLUDED
 
+#include <stdbool.h>
 #include <stdint.h>
 
 enum opcode {
     OPCODE_UNDEFINED = 0,
     OPCODE_CLS_00E0,
     OPCODE_RET_00EE,
+    OPCODE_SCD_00Cn,
+    OPCODE_SCR_00FB,
+    OPCODE_SCL_00FC,
+    OPCODE_EXIT_00FD,
+    OPCODE_LOW_00FE,
+    OPCODE_HIGH_00FF,
     OPCODE_SYS_0nnn,
     OPCODE_JP_1nnn,
     OPCODE_CALL_2nnn,
     OPCODE_SE_3xkk,
     OPCODE_SNE_4xkk,
     OPCODE_SE_5xy0,
+    OPCODE_LD_5xy2,
+    OPCODE_LD_5xy3,
     OPCODE_LD_6xkk,
     OPCODE_ADD_7xkk,
     OPCODE_LD_8xy0,
@@ -28,21 +37,45 @@ enum opcode {
     OPCODE_LD_Annn,
     OPCODE_JP_Bnnn,
     OPCODE_RND_Cxkk,
+    OPCODE_DRW_Dxy0,
     OPCODE_DRW_Dxyn,
     OPCODE_SKP_Ex9E,
     OPCODE_SKNP_ExA1,
+    OPCODE_LD_F000,
+    OPCODE_PLANE_Fn01,
+    OPCODE_AUDIO_F002,
     OPCODE_LD_Fx07,
     OPCODE_LD_Fx0A,
     OPCODE_LD_Fx15,
     OPCODE_LD_Fx18,
     OPCODE_ADD_Fx1E,
     OPCODE_LD_Fx29,
+    OPCODE_LD_Fx30,
     OPCODE_LD_Fx33,
+    OPCODE_LD_Fx3A,
     OPCODE_LD_Fx55,
     OPCODE_LD_Fx65,
+    OPCODE_LD_Fx75,
+    OPCODE_LD_Fx85,
     OPCODE_COUNT,
 };
 
+// Sequences of instructions that are recognized at decode time and run
+// by a single fused operation
+enum fusion {
+    FUSION_NONE = 0,
+    FUSION_LD_Annn_DRW_Dxyn,
+    FUSION_ADD_7xkk_SE_3xkk_JP_1nnn,
+    FUSION_LD_Fx07_SE_3xkk,
+    FUSION_COUNT,
+};
+
+enum {
+    INSTRUCTION_FUSION_MAX = 3,
+    INSTRUCTION_CYCLES_SPRITE_BYTE = 68,
+    INSTRUCTION_CYCLES_REGISTER = 14,
+};
+
 struct instruction {
     int opcode;
     uint16_t nnn;
@@ -58,6 +91,13 @@ enum instruction_status {
 };
 
 int instruction_decode(struct instruction* inst, uint16_t code);
+void instruction_operands(struct instruction* inst, uint16_t code);
+bool instruction_matches(uint16_t code, int opcode);
 const char* instruction_name(const struct instruction* inst);
+long instruction_cycles(const struct instruction* inst);
+
+int instruction_fuse(const int* opcodes, long count);
+long instruction_fusion_length(int fusion);
+const int* instruction_fusion_opcodes(int fusion);
 
 #endif
@@ -15,6 +15,12 @@ test_instruction_decode(void)
     } tests[] = {
         { .code = 0x00E0, .want = { .opcode = OPCODE_CLS_00E0 }},
         { .code = 0x00EE, .want = { .opcode = OPCODE_RET_00EE }},
+        { .code = 0x00C4, .want = { .opcode = OPCODE_SCD_00Cn, .n = 0x4 }},
+        { .code = 0x00FB, .want = { .opcode = OPCODE_SCR_00FB }},
+        { .code = 0x00FC, .want = { .opcode = OPCODE_SCL_00FC }},
+        { .code = 0x00FD, .want = { .opcode = OPCODE_EXIT_00FD }},
+        { .code = 0x00FE, .want = { .opcode = OPCODE_LOW_00FE }},
+        { .code = 0x00FF, .want = { .opcode = OPCODE_HIGH_00FF }},
         { .code = 0x0234, .want = { .opcode = OPCODE_SYS_0nnn, .nnn = 0x234 }},
         { .code = 0x1234, .want = { .opcode = OPCODE_JP_1nnn, .nnn = 0x234 }},
         { .code = 0x2234, .want = { .opcode = OPCODE_CALL_2nnn, .nnn = 0x234 }},
@@ -36,6 +42,7 @@ test_instruction_decode(void)
         { .code = 0xA234, .want = { .opcode = OPCODE_LD_Annn, .nnn = 0x234 }},
         { .code = 0xB234, .want = { .opcode = OPCODE_JP_Bnnn, .nnn = 0x234 }},
         { .code = 0xC234, .want = { .opcode = OPCODE_RND_Cxkk, .x = 0x2, .kk = 0x34 }},
+        { .code = 0xD230, .want = { .opcode = OPCODE_DRW_Dxy0, .x = 0x2, .y = 0x3 }},
         { .code = 0xD234, .want = { .opcode = OPCODE_DRW_Dxyn, .x = 0x2, .y = 0x3, .n = 0x4 }},
         { .code = 0xE29E, .want = { .opcode = OPCODE_SKP_Ex9E, .x = 0x2 }},
         { .code = 0xE2A1, .want = { .opcode = OPCODE_SKNP_ExA1, .x = 0x2 }},
@@ -45,9 +52,12 @@ test_instruction_decode(void)
         { .code = 0xF218, .want = { .opcode = OPCODE_LD_Fx18, .x = 0x2 }},
         { .code = 0xF21E, .want = { .opcode = OPCODE_ADD_Fx1E, .x = 0x2 }},
         { .code = 0xF229, .want = { .opcode = OPCODE_LD_Fx29, .x = 0x2 }},
+        { .code = 0xF230, .want = { .opcode = OPCODE_LD_Fx30, .x = 0x2 }},
         { .code = 0xF233, .want = { .opcode = OPCODE_LD_Fx33, .x = 0x2 }},
         { .code = 0xF255, .want = { .opcode = OPCODE_LD_Fx55, .x = 0x2 }},
         { .code = 0xF265, .want = { .opcode = OPCODE_LD_Fx65, .x = 0x2 }},
+        { .code = 0xF275, .want = { .opcode = OPCODE_LD_Fx75, .x = 0x2 }},
+        { .code = 0xF285, .want = { .opcode = OPCODE_LD_Fx85, .x = 0x2 }},
     };
     long num_tests = sizeof(tests) / sizeof(tests[0]);
 
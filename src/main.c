@@ -1,3 +1,4 @@
+#include <dirent.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -5,23 +6,228 @@
 
 #include <SDL2/SDL.h>
 
+#include "cache.h"
+#include "capture.h"
 #include "chip8.h"
+#include "memo.h"
+#include "pack.h"
+#include "phosphor.h"
+#include "quirk.h"
+#include "rollback.h"
+#include "telemetry.h"
 
 enum {
-    SKYLARK_DISPLAY_PIXEL_SIZE = 16,
+    SKYLARK_DISPLAY_PIXEL_SIZE = 8,
+    SKYLARK_GRID_PIXEL_SIZE = 2,
+    SKYLARK_FRAME_RATE = 60,
+    SKYLARK_NS_PER_SEC = 1000000000,
+    SKYLARK_NS_PER_MS = 1000000,
+    SKYLARK_REMOTE_KEYS = 0xf000,
+    SKYLARK_PERSISTENCE = 50,
+    SKYLARK_SCANLINE_LEVEL = 160,
+    SKYLARK_HEADLESS_SEED = 1,
 };
 
-int
-main(int argc, char* argv[])
+// How the display is scaled up to the window
+enum {
+    SKYLARK_FILTER_NEAREST = 0,
+    SKYLARK_FILTER_LINEAR,
+    SKYLARK_FILTER_SCANLINES,
+};
+
+// The conventional mapping of the hex keypad onto the left of a keyboard:
+//   1 2 3 C      1 2 3 4
+//   4 5 6 D  ->  Q W E R
+//   7 8 9 E      A S D F
+//   A 0 B F      Z X C V
+static const SDL_Keycode SKYLARK_KEYPAD[CHIP8_INPUT_SIZE] = {
+    SDLK_x, SDLK_1, SDLK_2, SDLK_3,
+    SDLK_q, SDLK_w, SDLK_e, SDLK_a,
+    SDLK_s, SDLK_d, SDLK_z, SDLK_c,
+    SDLK_4, SDLK_r, SDLK_f, SDLK_v,
+};
+
+// Colors for each combination of the two XO-CHIP planes
+static const SDL_Color SKYLARK_PALETTE[1 << CHIP8_PLANES] = {
+    { 0, 0, 0, 255 },
+    { 255, 255, 255, 255 },
+    { 85, 85, 85, 255 },
+    { 170, 170, 170, 255 },
+};
+
+static int
+keypad(SDL_Keycode key)
 {
-    if (argc != 2) {
-        fprintf(stderr, "usage: %s <rom_file>\n", argv[0]);
-        return EXIT_FAILURE;
+    for (int i = 0; i < CHIP8_INPUT_SIZE; i++) {
+        if (SKYLARK_KEYPAD[i] == key) return i;
+    }
+    return -1;
+}
+
+static uint64_t
+now_ns(void)
+{
+    // split the conversion so that large counter values do not overflow
+    uint64_t counter = SDL_GetPerformanceCounter();
+    uint64_t freq = SDL_GetPerformanceFrequency();
+    return (counter / freq) * SKYLARK_NS_PER_SEC + (counter % freq) * SKYLARK_NS_PER_SEC / freq;
+}
+
+static bool
+open_window(long width, long height, SDL_Window** window, SDL_Renderer** renderer)
+{
+    if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+        fprintf(stderr, "failed to init SDL2: %s\n", SDL_GetError());
+        return false;
+    }
+
+    *window = SDL_CreateWindow(
+        "Skylark CHIP-8 Emulator",
+        SDL_WINDOWPOS_UNDEFINED,
+        SDL_WINDOWPOS_UNDEFINED,
+        width,
+        height,
+        SDL_WINDOW_RESIZABLE);
+    if (*window == NULL) {
+        fprintf(stderr, "failed to create SDL2 window: %s\n", SDL_GetError());
+        SDL_Quit();
+        return false;
+    }
+
+    *renderer = SDL_CreateRenderer(*window, -1, SDL_RENDERER_ACCELERATED);
+    if (*renderer == NULL) {
+        fprintf(stderr, "failed to create SDL2 renderer: %s\n", SDL_GetError());
+        SDL_DestroyWindow(*window);
+        SDL_Quit();
+        return false;
+    }
+
+    return true;
+}
+
+static void
+close_window(SDL_Window* window, SDL_Renderer* renderer)
+{
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+}
+
+// Apply pending events to the keypad mask, returning false once asked to quit
+static bool
+poll_events(uint16_t* keys, struct telemetry* telemetry, uint64_t frame_start)
+{
+    bool running = true;
+    SDL_Event event = { 0 };
+    while (SDL_PollEvent(&event)) {
+        if (event.type == SDL_QUIT) running = false;
+        if (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP) {
+            SDL_Keycode key = event.key.keysym.sym;
+            if (key == SDLK_ESCAPE && event.type == SDL_KEYUP) running = false;
+
+            int index = keypad(key);
+            if (index < 0) continue;
+            if (event.type == SDL_KEYDOWN) *keys |= 1 << index;
+            else *keys &= ~(1 << index);
+
+            // latency is measured from the oldest input not yet presented
+            if (telemetry->input_ns == 0) telemetry->input_ns = frame_start;
+        }
+    }
+    return running;
+}
+
+static void
+present(SDL_Renderer* renderer, struct telemetry* telemetry)
+{
+    uint64_t present_start = now_ns();
+    SDL_RenderPresent(renderer);
+    uint64_t present_end = now_ns();
+
+    telemetry_record(&telemetry->present_time, present_end - present_start);
+    telemetry->frames_presented += 1;
+    if (telemetry->input_ns != 0) {
+        telemetry_record(&telemetry->input_latency, present_end - telemetry->input_ns);
+        telemetry->input_ns = 0;
+    }
+}
+
+// Sleep until the next frame is due, or skip the frames that were missed
+static void
+pace(struct telemetry* telemetry, uint64_t* next_frame, uint64_t frame_start)
+{
+    uint64_t frame_ns = SKYLARK_NS_PER_SEC / SKYLARK_FRAME_RATE;
+    *next_frame += frame_ns;
+    uint64_t now = now_ns();
+    telemetry_record(&telemetry->frame_time, now - frame_start);
+    if (now > *next_frame) {
+        telemetry->frames_dropped += (now - *next_frame) / frame_ns;
+        *next_frame = now;
+    } else {
+        SDL_Delay((*next_frame - now) / SKYLARK_NS_PER_MS);
+        uint64_t woke = now_ns();
+        telemetry->idle_ns += woke - now;
+        now = woke;
+    }
+
+    // an unwritable path is reported once rather than every second
+    int rc = telemetry_publish(telemetry, now);
+    if (rc != TELEMETRY_OK && !telemetry->reported) {
+        fprintf(stderr, "failed to publish telemetry to %s: %s\n", telemetry->path, telemetry_error_message(rc));
+        telemetry->reported = true;
+    }
+}
+
+// Darken every other row of the window by drawing a one pixel wide
+// texture of alternating rows over it, remade whenever the window height
+// changes so that its rows line up with the window's
+static void
+draw_scanlines(SDL_Renderer* renderer, SDL_Texture** texture, int* height)
+{
+    int w = 0;
+    int h = 0;
+    if (SDL_GetRendererOutputSize(renderer, &w, &h) != 0 || h <= 0) return;
+
+    if (*texture == NULL || h != *height) {
+        if (*texture != NULL) SDL_DestroyTexture(*texture);
+        *height = h;
+
+        uint32_t* rows = malloc(h * sizeof(*rows));
+        if (rows == NULL) {
+            *texture = NULL;
+            return;
+        }
+        for (int y = 0; y < h; y++) {
+            uint32_t level = y % 2 == 0 ? 255 : SKYLARK_SCANLINE_LEVEL;
+            rows[y] = 0xff000000 | level * 0x010101u;
+        }
+
+        SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "nearest");
+        *texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, 1, h);
+        if (*texture != NULL) {
+            SDL_UpdateTexture(*texture, NULL, rows, sizeof(*rows));
+            SDL_SetTextureBlendMode(*texture, SDL_BLENDMODE_MOD);
+        }
+        free(rows);
     }
 
-    FILE* fp = fopen(argv[1], "rb");
+    if (*texture != NULL) SDL_RenderCopy(renderer, *texture, NULL, NULL);
+}
+
+static void
+usage(const char* prog)
+{
+    fprintf(stderr, "usage: %s [-headless] [-frames n] [-hashes file] [-y4m file | -png dir] [-profile name] [-telemetry file] [-pack file] [-memo frames | -rollback delay] [-phosphor percent] [-filter nearest|linear|scanlines] [-timing steps|vip|vblank] [-seed n] <rom_file | rom_name>\n", prog);
+    fprintf(stderr, "       %s -grid [-profile name] [-timing steps|vip|vblank] [-telemetry file] <rom_dir>\n", prog);
+}
+
+
+static int
+load_file(struct chip8* chip8, const char* rom)
+{
+    FILE* fp = fopen(rom, "rb");
     if (fp == NULL) {
-        fprintf(stderr, "failed to open rom: %s\n", argv[1]);
+        fprintf(stderr, "failed to open rom: %s\n", rom);
         return EXIT_FAILURE;
     }
 
@@ -45,84 +251,601 @@ main(int argc, char* argv[])
     }
     fclose(fp);
 
-    struct chip8 chip8 = { 0 };
-    chip8_init(&chip8);
-
-    int rc = chip8_load(&chip8, buf, size);
+    int rc = chip8_load(chip8, buf, size);
+    free(buf);
     if (rc != CHIP8_OK) {
-        free(buf);
         fprintf(stderr, "failed to init chip8 emulator\n");
         return EXIT_FAILURE;
     }
-    free(buf);
 
-    if (SDL_Init(SDL_INIT_VIDEO) != 0) {
-        fprintf(stderr, "failed to init SDL2: %s\n", SDL_GetError());
+    return EXIT_SUCCESS;
+}
+
+// Load a ROM by name from a pack, copying straight out of the mapping
+static int
+load_pack(struct chip8* chip8, const char* path, const char* name)
+{
+    struct pack pack = { 0 };
+    int rc = pack_open(&pack, path);
+    if (rc != PACK_OK) {
+        fprintf(stderr, "failed to open pack %s: %s\n", path, pack_error_message(rc));
         return EXIT_FAILURE;
     }
 
-    SDL_Window* window = SDL_CreateWindow(
-        "Skylark CHIP-8 Emulator",
-        SDL_WINDOWPOS_UNDEFINED,
-        SDL_WINDOWPOS_UNDEFINED,
-        CHIP8_DISPLAY_WIDTH * SKYLARK_DISPLAY_PIXEL_SIZE,
-        CHIP8_DISPLAY_HEIGHT * SKYLARK_DISPLAY_PIXEL_SIZE,
-        SDL_WINDOW_RESIZABLE);
-    if (window == NULL) {
-        fprintf(stderr, "failed to create SDL2 window: %s\n", SDL_GetError());
+    struct pack_entry entry = { 0 };
+    rc = pack_find(&pack, name, &entry);
+    if (rc != PACK_OK) {
+        fprintf(stderr, "failed to find rom %s: %s\n", name, pack_error_message(rc));
+        pack_close(&pack);
         return EXIT_FAILURE;
     }
 
-    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-    if (renderer == NULL) {
-        fprintf(stderr, "failed to create SDL2 renderer: %s\n", SDL_GetError());
-        SDL_DestroyWindow(window);
+    rc = pack_load(&entry, chip8);
+    pack_close(&pack);
+    if (rc != CHIP8_OK) {
+        fprintf(stderr, "failed to init chip8 emulator\n");
         return EXIT_FAILURE;
     }
 
-    bool running = true;
-    while (running) {
-        // input
-        SDL_Event event = { 0 };
-        while (SDL_PollEvent(&event)) {
-            if (event.type == SDL_QUIT) running = false;
-            if (event.type == SDL_KEYUP) {
-                SDL_Keycode key = event.key.keysym.sym;
-                if (key == SDLK_ESCAPE) running = false;
-            }
+    return EXIT_SUCCESS;
+}
+
+// A local stand-in for a remote second player. The right column of the
+// keypad (C, D, E, F) belongs to that player, and its keys reach the
+// rollback engine delay frames after they were pressed.
+struct remote {
+    struct rollback rollback;
+    uint16_t sent[ROLLBACK_WINDOW];
+    long delay;
+    uint64_t rollback_ns;
+    uint64_t rollback_max_ns;
+};
+
+static int
+remote_frame(struct remote* remote, uint16_t keys)
+{
+    struct rollback* rollback = &remote->rollback;
+    long frame = rollback->frame;
+    remote->sent[frame % ROLLBACK_WINDOW] = keys & SKYLARK_REMOTE_KEYS;
+
+    // the delay is kept inside the window, so neither input can be refused
+    rollback_input(rollback, 0, frame, keys & ~SKYLARK_REMOTE_KEYS);
+    if (frame >= remote->delay) {
+        long sent = frame - remote->delay;
+        rollback_input(rollback, 1, sent, remote->sent[sent % ROLLBACK_WINDOW]);
+    }
+
+    bool rolling_back = rollback->pending >= 0;
+    uint64_t start = now_ns();
+    int rc = rollback_advance(rollback);
+    if (rolling_back) {
+        uint64_t elapsed = now_ns() - start;
+        remote->rollback_ns += elapsed;
+        if (elapsed > remote->rollback_max_ns) remote->rollback_max_ns = elapsed;
+    }
+    return rc;
+}
+
+static void
+remote_report(const struct remote* remote)
+{
+    struct rollback_stats stats = remote->rollback.stats;
+    double mean = stats.rollbacks > 0 ? (double)remote->rollback_ns / stats.rollbacks : 0;
+    fprintf(stderr, "rollback: %ld frames, %ld predicted, %ld rollbacks, %ld resimulated, %ld deepest, "
+        "%.1fus mean, %.1fus max per rollback\n",
+        stats.frames, stats.predicted, stats.rollbacks, stats.resimulated, stats.max_depth,
+        mean / 1000, remote->rollback_max_ns / 1000.0);
+}
+
+// Run without a window, hashing every frame and optionally recording video.
+// With a memo, frames already seen from the same state are replayed. With
+// a remote player, it presses a scripted pattern of its keys so that the
+// run doubles as a benchmark of rollback and resimulation.
+static int
+headless(struct chip8* chip8, long frames, const char* hashes, int format, const char* video, long memo_size, struct remote* remote)
+{
+    if (remote != NULL) chip8 = &remote->rollback.chip8;
+
+    struct memo memo = { 0 };
+    if (memo_size > 0) {
+        int rc = memo_init(&memo, memo_size);
+        if (rc != MEMO_OK) {
+            fprintf(stderr, "failed to init memo: %s\n", memo_error_message(rc));
+            return EXIT_FAILURE;
         }
+    }
 
-        // execute the next instruction
-        rc = chip8_step(&chip8);
+    struct capture capture = { 0 };
+    int rc = capture_open(&capture, hashes, format, video);
+    if (rc != CAPTURE_OK) {
+        fprintf(stderr, "failed to start capture: %s\n", capture_error_message(rc));
+        memo_free(&memo);
+        return EXIT_FAILURE;
+    }
+
+    int status = EXIT_SUCCESS;
+    for (long i = 0; frames < 0 || i < frames; i++) {
+        if (remote != NULL) {
+            uint16_t keys = i / 8 % 2 == 0 ? 0 : 1 << (0xc + i / 16 % 4);
+            rc = remote_frame(remote, keys);
+        } else {
+            rc = memo_size > 0 ? memo_frame(&memo, chip8) : chip8_frame(chip8);
+        }
         if (rc != CHIP8_OK) {
-            running = false;
+            fprintf(stderr, "failed to run frame: %s\n", chip8_error_message(rc));
+            status = EXIT_FAILURE;
             break;
         }
 
-        // graphics
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-        SDL_RenderClear(renderer);
+        rc = capture_frame(&capture, chip8);
+        if (rc != CAPTURE_OK) {
+            fprintf(stderr, "failed to capture frame: %s\n", capture_error_message(rc));
+            status = EXIT_FAILURE;
+            break;
+        }
+    }
+
+    rc = capture_close(&capture);
+    if (rc != CAPTURE_OK) {
+        fprintf(stderr, "failed to finish capture: %s\n", capture_error_message(rc));
+        status = EXIT_FAILURE;
+    }
+
+    if (memo_size > 0) {
+        struct memo_stats stats = memo.stats;
+        fprintf(stderr, "memo: %ld hits, %ld misses, %ld evictions, %ld collisions, %.1f%% hit rate\n",
+            stats.hits, stats.misses, stats.evictions, stats.collisions, memo_hit_rate(&memo) * 100);
+        memo_free(&memo);
+    }
+    if (remote != NULL) remote_report(remote);
+
+    return status;
+}
+
+// One machine in the grid, with its own decode cache so that cells
+// running the same ROM share its predecoded pages
+struct grid_cell {
+    struct chip8 chip8;
+    struct cache cache;
+    bool dirty;
+    bool faulted;
+};
+
+static int
+compare_names(const void* a, const void* b)
+{
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// List the ROMs in a directory by path, sorted so the grid has a stable layout
+static char**
+list_roms(const char* dir, long* count)
+{
+    DIR* d = opendir(dir);
+    if (d == NULL) {
+        fprintf(stderr, "failed to open rom directory: %s\n", dir);
+        return NULL;
+    }
+
+    *count = 0;
+    long capacity = 64;
+    char** paths = malloc(capacity * sizeof(*paths));
+    if (paths == NULL) {
+        closedir(d);
+        fprintf(stderr, "failed to allocate rom list\n");
+        return NULL;
+    }
+
+    struct dirent* ent;
+    while ((ent = readdir(d)) != NULL) {
+        if (ent->d_name[0] == '.') continue;
+
+        if (*count == capacity) {
+            capacity *= 2;
+            char** grown = realloc(paths, capacity * sizeof(*paths));
+            if (grown == NULL) {
+                fprintf(stderr, "failed to grow rom list, stopping at %ld roms\n", *count);
+                break;
+            }
+            paths = grown;
+        }
+
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+        paths[*count] = strdup(path);
+        if (paths[*count] != NULL) *count += 1;
+    }
+    closedir(d);
+
+    qsort(paths, *count, sizeof(*paths), compare_names);
+    return paths;
+}
+
+// Run one frame, noting whether anything drew to or cleared the display
+// and how many steps it took
+static int
+grid_frame(struct chip8* chip8, bool* drawn, long* steps)
+{
+    long budget = chip8_frame_steps(chip8);
+    *steps = 0;
+    while (*steps < budget) {
+        struct chip8_event event = { 0 };
+        int rc = chip8_run_until(chip8, CHIP8_EVENT_FRAME | CHIP8_EVENT_DISPLAY, budget - *steps, &event);
+        *steps += event.steps;
+        if (rc != CHIP8_OK) return rc;
 
-        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-        for (long y = 0; y < CHIP8_DISPLAY_HEIGHT; y++) {
-            for (long x = 0; x < CHIP8_DISPLAY_WIDTH; x++) {
-                if (!chip8_pixel_on(&chip8, x, y)) continue;
+        if (event.type & CHIP8_EVENT_DISPLAY) *drawn = true;
+        if (event.type & CHIP8_EVENT_FRAME) break;
+    }
+    return CHIP8_OK;
+}
+
+// Draw a cell into its slot of the atlas, doubling low resolution pixels
+static void
+grid_draw(const struct chip8* chip8, uint32_t* pixels, long pitch)
+{
+    long shift = chip8_display_width(chip8) == CHIP8_DISPLAY_WIDTH ? 0 : 1;
+    for (long y = 0; y < CHIP8_DISPLAY_HEIGHT; y++) {
+        uint32_t* row = pixels + y * pitch;
+        for (long x = 0; x < CHIP8_DISPLAY_WIDTH; x++) {
+            SDL_Color c = SKYLARK_PALETTE[chip8_pixel(chip8, x >> shift, y >> shift)];
+            row[x] = (uint32_t)c.a << 24 | (uint32_t)c.r << 16 | (uint32_t)c.g << 8 | c.b;
+        }
+    }
+}
 
-                SDL_Rect pixel = {
-                    .w = SKYLARK_DISPLAY_PIXEL_SIZE,
-                    .h = SKYLARK_DISPLAY_PIXEL_SIZE,
-                    .x = x * SKYLARK_DISPLAY_PIXEL_SIZE,
-                    .y = y * SKYLARK_DISPLAY_PIXEL_SIZE,
-                };
-                SDL_RenderFillRect(renderer, &pixel);
+// Each cell owns a slot in one streaming texture. Only cells that drew
+// are redrawn, the band of atlas rows they cover goes up in one upload,
+// and the whole atlas is drawn with one copy.
+static int
+grid_run(struct grid_cell* cells, long count, const char* metrics)
+{
+    long cols = 1;
+    while (cols * cols < count) cols++;
+    long rows = (count + cols - 1) / cols;
+    long width = cols * CHIP8_DISPLAY_WIDTH;
+    long height = rows * CHIP8_DISPLAY_HEIGHT;
+
+    uint32_t* pixels = calloc(width * height, sizeof(*pixels));
+    if (pixels == NULL) {
+        fprintf(stderr, "failed to allocate grid pixels\n");
+        return EXIT_FAILURE;
+    }
+
+    SDL_Window* window = NULL;
+    SDL_Renderer* renderer = NULL;
+    if (!open_window(width * SKYLARK_GRID_PIXEL_SIZE, height * SKYLARK_GRID_PIXEL_SIZE, &window, &renderer)) {
+        free(pixels);
+        return EXIT_FAILURE;
+    }
+
+    SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, width, height);
+    if (texture == NULL) {
+        fprintf(stderr, "failed to create SDL2 texture: %s\n", SDL_GetError());
+        close_window(window, renderer);
+        free(pixels);
+        return EXIT_FAILURE;
+    }
+
+    struct telemetry telemetry = { 0 };
+    telemetry_init(&telemetry, metrics, now_ns());
+
+    uint16_t keys = 0;
+    uint64_t next_frame = now_ns();
+    for (;;) {
+        uint64_t frame_start = now_ns();
+        if (!poll_events(&keys, &telemetry, frame_start)) break;
+
+        // every machine sees the same keys, and faulted ones stay frozen
+        for (long i = 0; i < count; i++) {
+            struct grid_cell* cell = &cells[i];
+            if (cell->faulted) continue;
+
+            chip8_set_input(&cell->chip8, keys);
+            long steps = 0;
+            int rc = grid_frame(&cell->chip8, &cell->dirty, &steps);
+            telemetry.instructions += steps;
+            if (rc != CHIP8_OK) {
+                fprintf(stderr, "cell %ld: failed to run frame: %s\n", i, chip8_error_message(rc));
+                cell->faulted = true;
             }
         }
-        SDL_RenderPresent(renderer);
+
+        long first = rows;
+        long last = -1;
+        for (long i = 0; i < count; i++) {
+            struct grid_cell* cell = &cells[i];
+            if (!cell->dirty) continue;
+
+            long row = i / cols;
+            long col = i % cols;
+            grid_draw(&cell->chip8, pixels + row * CHIP8_DISPLAY_HEIGHT * width + col * CHIP8_DISPLAY_WIDTH, width);
+            cell->dirty = false;
+            if (row < first) first = row;
+            if (row > last) last = row;
+        }
+
+        if (last >= 0) {
+            SDL_Rect band = {
+                .x = 0,
+                .y = first * CHIP8_DISPLAY_HEIGHT,
+                .w = width,
+                .h = (last - first + 1) * CHIP8_DISPLAY_HEIGHT,
+            };
+            SDL_UpdateTexture(texture, &band, pixels + band.y * width, width * sizeof(*pixels));
+        }
+
+        SDL_RenderCopy(renderer, texture, NULL, NULL);
+        present(renderer, &telemetry);
+        pace(&telemetry, &next_frame, frame_start);
     }
 
-    SDL_DestroyRenderer(renderer);
-    SDL_DestroyWindow(window);
-    SDL_Quit();
+    SDL_DestroyTexture(texture);
+    close_window(window, renderer);
+    free(pixels);
+
+    return EXIT_SUCCESS;
+}
+
+// Run every ROM in a directory side by side in one window
+static int
+grid(const char* dir, int quirks, int timing, const char* metrics)
+{
+    long count = 0;
+    char** paths = list_roms(dir, &count);
+    if (paths == NULL) return EXIT_FAILURE;
+
+    // cells are allocated up front since each machine points at its cache
+    struct grid_cell* cells = calloc(count > 0 ? count : 1, sizeof(*cells));
+    if (cells == NULL) {
+        fprintf(stderr, "failed to allocate %ld grid cells\n", count);
+        for (long i = 0; i < count; i++) free(paths[i]);
+        free(paths);
+        return EXIT_FAILURE;
+    }
+
+    // ROMs that fail to load are reported and left out of the grid
+    long loaded = 0;
+    for (long i = 0; i < count; i++) {
+        struct grid_cell* cell = &cells[loaded];
+        chip8_init(&cell->chip8);
+        cache_init(&cell->cache);
+        cell->chip8.cache = &cell->cache;
+        if (load_file(&cell->chip8, paths[i]) == EXIT_SUCCESS) {
+            if (quirks >= 0) cell->chip8.quirks = quirks;
+            chip8_set_timing(&cell->chip8, timing);
+            cell->dirty = true;
+            loaded += 1;
+        } else {
+            chip8_free(&cell->chip8);
+            cache_release(&cell->cache);
+        }
+        free(paths[i]);
+    }
+    free(paths);
+
+    int status = EXIT_FAILURE;
+    if (loaded == 0) {
+        fprintf(stderr, "no roms to run in %s\n", dir);
+    } else {
+        status = grid_run(cells, loaded, metrics);
+    }
+
+    for (long i = 0; i < loaded; i++) {
+        chip8_free(&cells[i].chip8);
+        cache_release(&cells[i].cache);
+    }
+    free(cells);
+
+    return status;
+}
+
+int
+main(int argc, char* argv[])
+{
+    bool is_headless = false;
+    bool is_grid = false;
+    long frames = -1;
+    const char* hashes = NULL;
+    const char* video = NULL;
+    int format = CAPTURE_FORMAT_NONE;
+    int quirks = -1;
+    const char* metrics = NULL;
+    const char* pack = NULL;
+    long memo_size = 0;
+    long delay = -1;
+    long persistence = SKYLARK_PERSISTENCE;
+    int filter = SKYLARK_FILTER_NEAREST;
+    int timing = CHIP8_TIMING_STEPS;
+    uint32_t seed = 0;
+
+    int arg = 1;
+    for (; arg < argc - 1; arg++) {
+        if (strcmp(argv[arg], "-headless") == 0) {
+            is_headless = true;
+        } else if (strcmp(argv[arg], "-grid") == 0) {
+            is_grid = true;
+        } else if (strcmp(argv[arg], "-frames") == 0 && arg + 2 < argc) {
+            frames = strtol(argv[++arg], NULL, 10);
+        } else if (strcmp(argv[arg], "-hashes") == 0 && arg + 2 < argc) {
+            hashes = argv[++arg];
+        } else if (strcmp(argv[arg], "-y4m") == 0 && arg + 2 < argc) {
+            format = CAPTURE_FORMAT_Y4M;
+            video = argv[++arg];
+        } else if (strcmp(argv[arg], "-png") == 0 && arg + 2 < argc) {
+            format = CAPTURE_FORMAT_PNG;
+            video = argv[++arg];
+        } else if (strcmp(argv[arg], "-pack") == 0 && arg + 2 < argc) {
+            pack = argv[++arg];
+        } else if (strcmp(argv[arg], "-memo") == 0 && arg + 2 < argc) {
+            memo_size = strtol(argv[++arg], NULL, 10);
+        } else if (strcmp(argv[arg], "-rollback") == 0 && arg + 2 < argc) {
+            delay = strtol(argv[++arg], NULL, 10);
+            if (delay < 0 || delay >= ROLLBACK_WINDOW) {
+                fprintf(stderr, "rollback delay must be under %d frames\n", ROLLBACK_WINDOW);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[arg], "-phosphor") == 0 && arg + 2 < argc) {
+            persistence = strtol(argv[++arg], NULL, 10);
+            if (persistence < 0 || persistence > 99) {
+                fprintf(stderr, "phosphor persistence must be 0 to 99 percent\n");
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[arg], "-filter") == 0 && arg + 2 < argc) {
+            const char* name = argv[++arg];
+            if (strcmp(name, "nearest") == 0) filter = SKYLARK_FILTER_NEAREST;
+            else if (strcmp(name, "linear") == 0) filter = SKYLARK_FILTER_LINEAR;
+            else if (strcmp(name, "scanlines") == 0) filter = SKYLARK_FILTER_SCANLINES;
+            else {
+                fprintf(stderr, "unknown filter: %s\n", name);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[arg], "-timing") == 0 && arg + 2 < argc) {
+            const char* name = argv[++arg];
+            if (strcmp(name, "steps") == 0) timing = CHIP8_TIMING_STEPS;
+            else if (strcmp(name, "vip") == 0) timing = CHIP8_TIMING_VIP;
+            else if (strcmp(name, "vblank") == 0) timing = CHIP8_TIMING_VIP_VBLANK;
+            else {
+                fprintf(stderr, "unknown timing: %s\n", name);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[arg], "-seed") == 0 && arg + 2 < argc) {
+            unsigned long value = strtoul(argv[++arg], NULL, 0);
+            if (value == 0 || value > UINT32_MAX) {
+                fprintf(stderr, "seed must be 1 to %lu\n", (unsigned long)UINT32_MAX);
+                return EXIT_FAILURE;
+            }
+            seed = value;
+        } else if (strcmp(argv[arg], "-telemetry") == 0 && arg + 2 < argc) {
+            metrics = argv[++arg];
+        } else if (strcmp(argv[arg], "-profile") == 0 && arg + 2 < argc) {
+            quirks = quirk_profile(argv[++arg]);
+            if (quirks < 0) {
+                fprintf(stderr, "unknown quirk profile: %s\n", argv[arg]);
+                return EXIT_FAILURE;
+            }
+        } else {
+            break;
+        }
+    }
+
+    bool is_rollback = delay >= 0;
+    if (arg != argc - 1 || (is_grid && (is_headless || pack != NULL || is_rollback)) || (is_rollback && memo_size > 0)) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (is_grid) {
+        return grid(argv[arg], quirks, timing, metrics);
+    }
+
+    struct chip8 chip8 = { 0 };
+    chip8_init(&chip8);
+
+    // loading attaches the decode cache to the shared pages for the ROM
+    struct cache cache;
+    cache_init(&cache);
+    chip8.cache = &cache;
+
+    const char* rom = argv[arg];
+    int rc = pack != NULL ? load_pack(&chip8, pack, rom) : load_file(&chip8, rom);
+    if (rc != EXIT_SUCCESS) return rc;
+
+    // an explicit profile overrides the one picked from the ROM database
+    if (quirks >= 0) chip8.quirks = quirks;
+    chip8_set_timing(&chip8, timing);
+
+    // headless runs are compared by their hashes, so Cxkk must not depend on the clock
+    if (seed == 0 && is_headless) seed = SKYLARK_HEADLESS_SEED;
+    if (seed != 0) chip8.rng = seed;
+
+    // the rollback engine runs its own copy of the machine from here on
+    static struct remote remote;
+    struct chip8* machine = &chip8;
+    if (is_rollback) {
+        rc = rollback_init(&remote.rollback, &chip8);
+        if (rc != ROLLBACK_OK) {
+            fprintf(stderr, "failed to init rollback: %s\n", rollback_error_message(rc));
+            return EXIT_FAILURE;
+        }
+        remote.delay = delay;
+        machine = &remote.rollback.chip8;
+    }
+
+    if (is_headless) {
+        return headless(&chip8, frames, hashes, format, video, memo_size, is_rollback ? &remote : NULL);
+    }
+
+    SDL_Window* window = NULL;
+    SDL_Renderer* renderer = NULL;
+    long width = CHIP8_DISPLAY_WIDTH * SKYLARK_DISPLAY_PIXEL_SIZE;
+    long height = CHIP8_DISPLAY_HEIGHT * SKYLARK_DISPLAY_PIXEL_SIZE;
+    if (!open_window(width, height, &window, &renderer)) return EXIT_FAILURE;
+
+    // the palette is all grays, so one intensity per color is enough
+    static struct phosphor phosphor;
+    uint8_t levels[1 << CHIP8_PLANES];
+    for (int i = 0; i < 1 << CHIP8_PLANES; i++) levels[i] = SKYLARK_PALETTE[i].r;
+    phosphor_init(&phosphor, levels, persistence);
+
+    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, filter == SKYLARK_FILTER_LINEAR ? "linear" : "nearest");
+    SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+        PHOSPHOR_WIDTH, PHOSPHOR_HEIGHT);
+    if (texture == NULL) {
+        fprintf(stderr, "failed to create SDL2 texture: %s\n", SDL_GetError());
+        close_window(window, renderer);
+        return EXIT_FAILURE;
+    }
+
+    SDL_Texture* scanlines = NULL;
+    int scanlines_height = 0;
+
+    struct telemetry telemetry = { 0 };
+    telemetry_init(&telemetry, metrics, now_ns());
+
+    uint16_t keys = 0;
+    uint64_t next_frame = now_ns();
+    for (;;) {
+        uint64_t frame_start = now_ns();
+
+        // input
+        if (!poll_events(&keys, &telemetry, frame_start)) break;
+
+        // execute the next frame, counting every step run including resimulation
+        if (is_rollback) {
+            long steps = remote.rollback.stats.steps;
+            rc = remote_frame(&remote, keys);
+            telemetry.instructions += remote.rollback.stats.steps - steps;
+        } else {
+            struct chip8_event event = { 0 };
+            chip8_set_input(&chip8, keys);
+            rc = chip8_run_until(&chip8, CHIP8_EVENT_FRAME, chip8_frame_steps(&chip8), &event);
+            telemetry.instructions += event.steps;
+        }
+        if (rc != CHIP8_OK) {
+            fprintf(stderr, "failed to run frame: %s\n", chip8_error_message(rc));
+            break;
+        }
+
+        // graphics, faded through the phosphor and drawn as one texture
+        phosphor_frame(&phosphor, machine);
+        SDL_UpdateTexture(texture, NULL, phosphor.argb, PHOSPHOR_WIDTH * sizeof(*phosphor.argb));
+        SDL_RenderCopy(renderer, texture, NULL, NULL);
+        if (filter == SKYLARK_FILTER_SCANLINES) draw_scanlines(renderer, &scanlines, &scanlines_height);
+
+        present(renderer, &telemetry);
+        pace(&telemetry, &next_frame, frame_start);
+    }
+
+    if (scanlines != NULL) SDL_DestroyTexture(scanlines);
+    SDL_DestroyTexture(texture);
+    close_window(window, renderer);
+    if (is_rollback) {
+        remote_report(&remote);
+        rollback_free(&remote.rollback);
+    }
+    chip8_free(&chip8);
+    cache_release(&cache);
 
     return EXIT_SUCCESS;
 }
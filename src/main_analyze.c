@@ -0,0 +1,220 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "analyze.h"
+#include "chip8.h"
+#include "inst.h"
+#include "quirk.h"
+
+struct job {
+    const char* path;
+    struct analyze analyze;
+    int rc;
+};
+
+struct scan {
+    pthread_mutex_t lock;
+    struct job* jobs;
+    long count;
+    long next;
+};
+
+static int
+analyze_file(struct analyze* analyze, const char* path, uint8_t* buf)
+{
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL) return -1;
+
+    // a full memory's worth is already oversized, so one read is enough
+    long size = fread(buf, 1, CHIP8_XO_MEM_SIZE, fp);
+    fclose(fp);
+
+    return analyze_rom(analyze, buf, size);
+}
+
+// Each worker pulls the next ROM off the shared list until none are left
+static void*
+scan_worker(void* arg)
+{
+    struct scan* scan = arg;
+
+    uint8_t* buf = malloc(CHIP8_XO_MEM_SIZE);
+    for (;;) {
+        pthread_mutex_lock(&scan->lock);
+        long i = scan->next++;
+        pthread_mutex_unlock(&scan->lock);
+        if (i >= scan->count) break;
+
+        struct job* job = &scan->jobs[i];
+        job->rc = buf != NULL ? analyze_file(&job->analyze, job->path, buf) : ANALYZE_ERROR_ALLOC;
+    }
+
+    free(buf);
+    return NULL;
+}
+
+static const char*
+opcode_name(int opcode)
+{
+    struct instruction inst = { .opcode = opcode };
+
+    // drop the common "OPCODE_" prefix
+    return instruction_name(&inst) + sizeof("OPCODE_") - 1;
+}
+
+static void
+print_listing(const struct analyze* analyze)
+{
+    const uint8_t* mem = analyze->mem;
+    long rom_end = CHIP8_ROM_ADDR + analyze->rom_size;
+
+    long data = -1;
+    for (long addr = 0; addr <= analyze->mem_size; addr++) {
+        uint8_t flags = addr < analyze->mem_size ? analyze->flags[addr] : 0;
+        bool in_rom = addr >= CHIP8_ROM_ADDR && addr < rom_end;
+
+        // collapse runs of untraced ROM bytes into a single line
+        if (in_rom && !(flags & (ANALYZE_CODE | ANALYZE_BAD))) {
+            if (data < 0) data = addr;
+            continue;
+        }
+        if (data >= 0) {
+            printf("  %04lx: data, %ld bytes\n", data, addr - data);
+            data = -1;
+        }
+
+        uint16_t code = mem[addr] << 8 | mem[addr + 1];
+        if (flags & ANALYZE_BAD) {
+            printf("  %04lx: %04x  bad\n", addr, code);
+        } else if (flags & ANALYZE_START) {
+            if (flags & ANALYZE_LEADER) printf("block_%04lx:\n", addr);
+
+            struct instruction inst = { 0 };
+            instruction_decode(&inst, code);
+            printf("  %04lx: %04x  %s%s\n", addr, code, opcode_name(inst.opcode),
+                flags & ANALYZE_WRITTEN ? "  (written)" : "");
+        }
+    }
+}
+
+static void
+print_cfg(const struct analyze* analyze, const char* path)
+{
+    printf("digraph \"%s\" {\n", path);
+    for (long i = 0; i < analyze->block_count; i++) {
+        const struct analyze_block* block = &analyze->blocks[i];
+        printf("    b%04x [label=\"%04x-%04x\"];\n", block->start, block->start, block->end);
+        for (int j = 0; j < block->count; j++) {
+            const char* style = analyze->flags[block->next[j]] & ANALYZE_BAD ? " [color=red]" : "";
+            printf("    b%04x -> b%04x%s;\n", block->start, block->next[j], style);
+        }
+    }
+    printf("}\n");
+}
+
+int
+main(int argc, char* argv[])
+{
+    long threads = 4;
+    bool list = false;
+    bool cfg = false;
+    bool histogram = false;
+
+    int arg = 1;
+    for (; arg < argc; arg++) {
+        if (strcmp(argv[arg], "-threads") == 0 && arg + 1 < argc) {
+            threads = strtol(argv[++arg], NULL, 10);
+        } else if (strcmp(argv[arg], "-list") == 0) {
+            list = true;
+        } else if (strcmp(argv[arg], "-cfg") == 0) {
+            cfg = true;
+        } else if (strcmp(argv[arg], "-histogram") == 0) {
+            histogram = true;
+        } else {
+            break;
+        }
+    }
+
+    if (arg >= argc || threads < 1) {
+        fprintf(stderr, "usage: %s [-threads n] [-list] [-cfg] [-histogram] <rom_file>...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    struct scan scan = { 0 };
+    scan.count = argc - arg;
+    scan.jobs = calloc(scan.count, sizeof(*scan.jobs));
+    if (scan.jobs == NULL) {
+        fprintf(stderr, "failed to allocate %ld jobs\n", scan.count);
+        return EXIT_FAILURE;
+    }
+    for (long i = 0; i < scan.count; i++) scan.jobs[i].path = argv[arg + i];
+    pthread_mutex_init(&scan.lock, NULL);
+
+    if (threads > scan.count) threads = scan.count;
+    pthread_t workers[threads];
+    long started = 0;
+    for (; started < threads; started++) {
+        if (pthread_create(&workers[started], NULL, scan_worker, &scan) != 0) break;
+    }
+
+    // with no threads at all the scan still runs, just on this one
+    if (started == 0) scan_worker(&scan);
+    for (long t = 0; t < started; t++) pthread_join(workers[t], NULL);
+    pthread_mutex_destroy(&scan.lock);
+
+    // results are printed in the order given, whatever order they finished in
+    long totals[OPCODE_COUNT] = { 0 };
+    long rejected = 0;
+    for (long i = 0; i < scan.count; i++) {
+        struct job* job = &scan.jobs[i];
+        struct analyze* analyze = &job->analyze;
+        if (job->rc != ANALYZE_OK) {
+            const char* reason = job->rc < 0 ? "failed to open rom" : analyze_error_message(job->rc);
+            fprintf(stderr, "%s: %s\n", job->path, reason);
+            rejected += 1;
+            continue;
+        }
+
+        const char* platform = analyze->xochip ? "xochip" : analyze->schip ? "schip" : "chip8";
+        // the quirk database knows best, and SUPER-CHIP opcodes suggest its
+        // profile for ROMs it does not know. Unnamed combinations are printed
+        // as the raw bitmask that -profile accepts.
+        int quirks = analyze->chip8.quirks & CHIP8_QUIRK_MASK;
+        if (quirks == CHIP8_PROFILE_DEFAULT && analyze->schip && !analyze->xochip) quirks = CHIP8_PROFILE_SCHIP;
+        char mask[8];
+        const char* profile = quirk_name(quirks);
+        if (profile == NULL) {
+            snprintf(mask, sizeof(mask), "0x%02x", quirks);
+            profile = mask;
+        }
+        bool plain = analyze->mem_size > CHIP8_MEM_SIZE || analyze->self_modifying > 0;
+        printf("%s: %ld bytes, %ld instructions, %ld blocks, %ld data bytes, %ld bad, "
+            "%ld self-modifying, %ld unknown stores, %ld indirect, platform %s, profile %s, engine %s\n",
+            job->path, analyze->rom_size, analyze->instructions, analyze->block_count,
+            analyze->data_bytes, analyze->bad_words, analyze->self_modifying,
+            analyze->unknown_stores, analyze->indirect_jumps, platform, profile,
+            plain ? "plain" : "cached");
+
+        if (list) print_listing(analyze);
+        if (cfg) print_cfg(analyze, job->path);
+
+        for (long op = 0; op < OPCODE_COUNT; op++) totals[op] += analyze->histogram[op];
+        if (analyze->bad_words > 0) rejected += 1;
+        analyze_free(analyze);
+    }
+
+    if (histogram) {
+        for (long op = OPCODE_UNDEFINED + 1; op < OPCODE_COUNT; op++) {
+            if (totals[op] > 0) printf("%-12s %ld\n", opcode_name(op), totals[op]);
+        }
+    }
+
+    free(scan.jobs);
+
+    // any ROM that would hit a bad instruction at runtime fails the scan
+    return rejected > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
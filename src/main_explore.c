@@ -0,0 +1,77 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "explore.h"
+
+int
+main(int argc, char* argv[])
+{
+    long depth = 8;
+    long threads = 4;
+    long max_states = 16384;
+
+    int arg = 1;
+    for (; arg < argc - 1; arg++) {
+        if (strcmp(argv[arg], "-depth") == 0 && arg + 2 < argc) {
+            depth = strtol(argv[++arg], NULL, 10);
+        } else if (strcmp(argv[arg], "-threads") == 0 && arg + 2 < argc) {
+            threads = strtol(argv[++arg], NULL, 10);
+        } else if (strcmp(argv[arg], "-memory") == 0 && arg + 2 < argc) {
+            max_states = strtol(argv[++arg], NULL, 10);
+        } else {
+            break;
+        }
+    }
+
+    if (arg != argc - 1 || depth < 0 || threads < 1 || max_states < 1) {
+        fprintf(stderr, "usage: %s [-depth n] [-threads n] [-memory states] <rom_file>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    FILE* fp = fopen(argv[arg], "rb");
+    if (fp == NULL) {
+        fprintf(stderr, "failed to open rom: %s\n", argv[arg]);
+        return EXIT_FAILURE;
+    }
+
+    static uint8_t rom[CHIP8_XO_MEM_SIZE];
+    long size = fread(rom, 1, sizeof(rom), fp);
+    fclose(fp);
+
+    // every run starts from the same RNG seed so results are repeatable
+    struct chip8 start = { 0 };
+    chip8_init(&start);
+    start.rng = 1;
+    if (chip8_load(&start, rom, size) != CHIP8_OK) {
+        fprintf(stderr, "failed to load rom: %s\n", argv[arg]);
+        return EXIT_FAILURE;
+    }
+
+    struct explore explore = { 0 };
+    int rc = explore_init(&explore, threads, max_states);
+    if (rc != EXPLORE_OK) {
+        fprintf(stderr, "failed to init explorer: %s\n", explore_error_message(rc));
+        return EXIT_FAILURE;
+    }
+
+    rc = explore_run(&explore, &start, depth);
+    if (rc != EXPLORE_OK) {
+        fprintf(stderr, "failed to explore: %s\n", explore_error_message(rc));
+        explore_free(&explore);
+        return EXIT_FAILURE;
+    }
+
+    struct explore_stats stats = explore.stats;
+    printf("depth:      %ld\n", stats.depth);
+    printf("states:     %ld\n", stats.states);
+    printf("frames:     %ld\n", stats.frames);
+    printf("duplicates: %ld\n", stats.duplicates);
+    printf("faults:     %ld\n", stats.faults);
+    printf("spilled:    %ld\n", stats.spilled);
+
+    explore_free(&explore);
+    return EXIT_SUCCESS;
+}
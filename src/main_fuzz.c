@@ -0,0 +1,107 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "chip8.h"
+#include "fuzz.h"
+
+enum {
+    FUZZ_CHECK_INTERVAL = 4096,
+};
+
+static double
+now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Write a finding out as a ROM that skylark can run directly
+static void
+save_case(const struct fuzz_case* fc, const char* dir, long number)
+{
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/fuzz-%ld.rom", dir, number);
+    FILE* fp = fopen(path, "wb");
+    if (fp == NULL || fwrite(fc->rom, 1, fc->size, fp) != (size_t)fc->size) {
+        printf("failed to save case to %s\n", path);
+    } else {
+        printf("saved case to %s\n", path);
+    }
+    if (fp != NULL) fclose(fp);
+
+    printf("inputs:");
+    for (long i = 0; i < FUZZ_FRAMES; i++) printf(" %04x", fc->inputs[i]);
+    printf("\n");
+}
+
+int
+main(int argc, char* argv[])
+{
+    uint64_t seed = 1;
+    long cases = -1;
+    double seconds = 10;
+    const char* dir = ".";
+
+    int arg = 1;
+    for (; arg < argc; arg++) {
+        if (strcmp(argv[arg], "-seed") == 0 && arg + 1 < argc) {
+            seed = strtoull(argv[++arg], NULL, 0);
+        } else if (strcmp(argv[arg], "-cases") == 0 && arg + 1 < argc) {
+            cases = strtol(argv[++arg], NULL, 10);
+        } else if (strcmp(argv[arg], "-seconds") == 0 && arg + 1 < argc) {
+            seconds = strtod(argv[++arg], NULL);
+        } else if (strcmp(argv[arg], "-out") == 0 && arg + 1 < argc) {
+            dir = argv[++arg];
+        } else {
+            break;
+        }
+    }
+
+    if (arg != argc) {
+        fprintf(stderr, "usage: %s [-seed n] [-cases n] [-seconds n] [-out dir]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    static struct fuzz fuzz;
+    int rc = fuzz_init(&fuzz, seed);
+    if (rc != FUZZ_OK) {
+        fprintf(stderr, "failed to init fuzzer: %s\n", fuzz_error_message(rc));
+        return EXIT_FAILURE;
+    }
+
+    double start = now_seconds();
+    double elapsed = 0;
+    struct fuzz_case fc;
+    for (long i = 0; cases < 0 || i < cases; i++) {
+        if (i % FUZZ_CHECK_INTERVAL == 0) {
+            elapsed = now_seconds() - start;
+            if (cases < 0 && elapsed >= seconds) break;
+        }
+
+        fuzz_next(&fuzz, &fc);
+        rc = fuzz_run(&fuzz, &fc);
+        if (rc != FUZZ_OK) {
+            printf("case %ld: %s\n", i, fuzz_error_message(rc));
+            save_case(&fc, dir, i);
+            break;
+        }
+    }
+    elapsed = now_seconds() - start;
+
+    struct fuzz_stats stats = fuzz.stats;
+    printf("cases:    %ld\n", stats.cases);
+    printf("per sec:  %.0f\n", elapsed > 0 ? stats.cases / elapsed : 0);
+    printf("steps:    %ld\n", stats.steps);
+    printf("faults:   %ld\n", stats.faults);
+    printf("corpus:   %ld\n", fuzz.corpus_count);
+    printf("pcs:      %ld\n", stats.pcs);
+    printf("opcodes:  %ld / %d\n", stats.opcodes, OPCODE_COUNT);
+    printf("pairs:    %ld\n", stats.pairs);
+
+    fuzz_free(&fuzz);
+    return rc == FUZZ_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+}
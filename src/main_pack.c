@@ -0,0 +1,118 @@
+#include <dirent.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "hash.h"
+#include "pack.h"
+#include "quirk.h"
+
+// Read one ROM into the entry, returning false if it should be skipped
+static bool
+read_rom(struct pack_entry* entry, const char* dir, const char* name, int quirks)
+{
+    if (strlen(name) >= PACK_NAME_SIZE) {
+        fprintf(stderr, "skipping rom with a name that is too long: %s\n", name);
+        return false;
+    }
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL) {
+        fprintf(stderr, "skipping rom that failed to open: %s\n", path);
+        return false;
+    }
+
+    // a full memory's worth is already oversized, so one read is enough
+    uint8_t* data = malloc(CHIP8_XO_MEM_SIZE);
+    long size = data != NULL ? (long)fread(data, 1, CHIP8_XO_MEM_SIZE, fp) : 0;
+    fclose(fp);
+    if (data == NULL || size == 0 || CHIP8_ROM_ADDR + size > CHIP8_XO_MEM_SIZE) {
+        fprintf(stderr, "skipping rom that is empty or oversized: %s\n", path);
+        free(data);
+        return false;
+    }
+
+    memset(entry, 0, sizeof(*entry));
+    strcpy(entry->name, name);
+    entry->hash = hash_bytes(data, size);
+    entry->size = size;
+    entry->quirks = quirks >= 0 ? quirks : quirk_lookup(entry->hash);
+    entry->data = data;
+    return true;
+}
+
+int
+main(int argc, char* argv[])
+{
+    int quirks = -1;
+
+    int arg = 1;
+    for (; arg < argc - 2; arg++) {
+        if (strcmp(argv[arg], "-profile") == 0 && arg + 3 < argc) {
+            quirks = quirk_profile(argv[++arg]);
+            if (quirks < 0) {
+                fprintf(stderr, "unknown quirk profile: %s\n", argv[arg]);
+                return EXIT_FAILURE;
+            }
+        } else {
+            break;
+        }
+    }
+
+    if (arg != argc - 2) {
+        fprintf(stderr, "usage: %s [-profile name] <pack_file> <rom_dir>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const char* output = argv[arg];
+    const char* dir = argv[arg + 1];
+
+    DIR* d = opendir(dir);
+    if (d == NULL) {
+        fprintf(stderr, "failed to open rom directory: %s\n", dir);
+        return EXIT_FAILURE;
+    }
+
+    long count = 0;
+    long capacity = 64;
+    struct pack_entry* entries = malloc(capacity * sizeof(*entries));
+    if (entries == NULL) {
+        closedir(d);
+        fprintf(stderr, "failed to allocate pack entries\n");
+        return EXIT_FAILURE;
+    }
+
+    struct dirent* ent;
+    while ((ent = readdir(d)) != NULL) {
+        if (ent->d_name[0] == '.') continue;
+
+        if (count == capacity) {
+            capacity *= 2;
+            struct pack_entry* grown = realloc(entries, capacity * sizeof(*entries));
+            if (grown == NULL) {
+                fprintf(stderr, "failed to grow pack entries, stopping at %ld roms\n", count);
+                break;
+            }
+            entries = grown;
+        }
+        if (read_rom(&entries[count], dir, ent->d_name, quirks)) count += 1;
+    }
+    closedir(d);
+
+    int rc = pack_write(output, entries, count);
+    for (long i = 0; i < count; i++) free((void*)entries[i].data);
+    free(entries);
+
+    if (rc != PACK_OK) {
+        fprintf(stderr, "failed to write pack: %s\n", pack_error_message(rc));
+        return EXIT_FAILURE;
+    }
+
+    printf("packed %ld roms into %s\n", count, output);
+    return EXIT_SUCCESS;
+}
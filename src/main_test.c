@@ -4,18 +4,55 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "analyze_test.c"
+#include "cache_test.c"
+#include "capture_test.c"
+#include "chip8_test.c"
+#include "explore_test.c"
+#include "fuzz_test.c"
+#include "hash_test.c"
 #include "inst_test.c"
+#include "memo_test.c"
 #include "op_test.c"
+#include "pack_test.c"
+#include "phosphor_test.c"
+#include "pool_test.c"
+#include "rollback_test.c"
+#include "scheduler_test.c"
+#include "telemetry_test.c"
 
 typedef bool (*test_func)(void);
 
 static const test_func TESTS[] = {
+    test_analyze_rom,
+    test_cache_fusion,
+    test_cache_shared,
+    test_capture_hash,
+    test_capture_y4m,
+    test_chip8_run_until,
+    test_chip8_vip_timing,
+    test_explore_run,
+    test_fuzz_run,
+    test_hash_wide,
     test_instruction_decode,
+    test_memo_frame,
     test_operation_UNDEFINED,
     test_operation_CLS_00E0,
     test_operation_RET_00EE,
     test_operation_SYS_0nnn,
     test_operation_JP_1nnn,
+    test_operation_SKP_Ex9E,
+    test_operation_quirks,
+    test_operation_memory_guard,
+    test_operation_schip,
+    test_operation_xochip,
+    test_pack_roundtrip,
+    test_phosphor_decay,
+    test_pool_reset,
+    test_rollback_resimulate,
+    test_scheduler_park,
+    test_scheduler_timers,
+    test_telemetry_publish,
 };
 
 int
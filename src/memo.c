@@ -0,0 +1,176 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "memo.h"
+
+// Compare exactly the state that chip8_hash covers
+static bool
+memo_same(const struct chip8* a, const struct chip8* b)
+{
+    if (memcmp(a, b, offsetof(struct chip8, input)) != 0) return false;
+    if (memcmp(&a->hires, &b->hires, offsetof(struct chip8, mem) - offsetof(struct chip8, hires)) != 0) return false;
+    if (memcmp(a->mem, b->mem, CHIP8_MEM_SIZE) != 0) return false;
+    return memcmp(a->display, b->display, sizeof(a->display)) == 0;
+}
+
+static void
+memo_unlink(struct memo* memo, long i)
+{
+    struct memo_entry* entry = &memo->entries[i];
+    if (entry->newer >= 0) memo->entries[entry->newer].older = entry->older;
+    else memo->newest = entry->older;
+    if (entry->older >= 0) memo->entries[entry->older].newer = entry->newer;
+    else memo->oldest = entry->newer;
+}
+
+static void
+memo_push(struct memo* memo, long i)
+{
+    struct memo_entry* entry = &memo->entries[i];
+    entry->newer = -1;
+    entry->older = memo->newest;
+    if (memo->newest >= 0) memo->entries[memo->newest].newer = i;
+    memo->newest = i;
+    if (memo->oldest < 0) memo->oldest = i;
+}
+
+static long*
+memo_bucket(struct memo* memo, uint64_t hash, uint16_t input)
+{
+    return &memo->buckets[(hash ^ input) & memo->bucket_mask];
+}
+
+int
+memo_init(struct memo* memo, long capacity)
+{
+    assert(memo != NULL);
+    assert(capacity > 0);
+
+    memset(memo, 0, sizeof(*memo));
+    memo->capacity = capacity;
+    memo->newest = -1;
+    memo->oldest = -1;
+
+    // keep chains short with at least two buckets per entry
+    long buckets = 1;
+    while (buckets < capacity * 2) buckets *= 2;
+    memo->bucket_mask = buckets - 1;
+
+    memo->entries = calloc(capacity, sizeof(*memo->entries));
+    memo->buckets = malloc(buckets * sizeof(*memo->buckets));
+    if (memo->entries == NULL || memo->buckets == NULL) {
+        memo_free(memo);
+        return MEMO_ERROR_ALLOC;
+    }
+    for (long i = 0; i < buckets; i++) memo->buckets[i] = -1;
+
+    return MEMO_OK;
+}
+
+int
+memo_frame(struct memo* memo, struct chip8* chip8)
+{
+    assert(memo != NULL);
+    assert(chip8 != NULL);
+
+    if (chip8->xmem != NULL) {
+        memo->stats.bypassed += 1;
+        return chip8_frame(chip8);
+    }
+
+    uint64_t hash = chip8_hash(chip8);
+    uint16_t input = chip8_input_mask(chip8);
+    long* bucket = memo_bucket(memo, hash, input);
+    memo->stats.lookups += 1;
+
+    for (long i = *bucket; i >= 0; i = memo->entries[i].chain) {
+        struct memo_entry* entry = &memo->entries[i];
+        if (entry->hash != hash || entry->input != input) continue;
+        if (!memo_same(&entry->before, chip8)) {
+            memo->stats.collisions += 1;
+            continue;
+        }
+
+        // the attached decode cache checks every entry against memory,
+        // so it stays correct when memory is replaced wholesale
+        struct cache* cache = chip8->cache;
+        memcpy(chip8, &entry->after, sizeof(*chip8));
+        chip8->cache = cache;
+
+        memo_unlink(memo, i);
+        memo_push(memo, i);
+        memo->stats.hits += 1;
+        return entry->rc;
+    }
+
+    memo->stats.misses += 1;
+
+    struct chip8 before;
+    memcpy(&before, chip8, sizeof(before));
+    int rc = chip8_frame(chip8);
+
+    // a frame that grew into extended memory cannot be replayed by copy
+    if (chip8->xmem != NULL) return rc;
+
+    // reuse the least recently used entry once the memo is full
+    long i = memo->count;
+    if (memo->count < memo->capacity) {
+        memo->count += 1;
+    } else {
+        i = memo->oldest;
+        memo_unlink(memo, i);
+        long* link = memo_bucket(memo, memo->entries[i].hash, memo->entries[i].input);
+        while (*link != i) link = &memo->entries[*link].chain;
+        *link = memo->entries[i].chain;
+        memo->stats.evictions += 1;
+    }
+
+    struct memo_entry* entry = &memo->entries[i];
+    entry->hash = hash;
+    entry->input = input;
+    entry->rc = rc;
+    memcpy(&entry->before, &before, sizeof(before));
+    memcpy(&entry->after, chip8, sizeof(*chip8));
+    entry->before.cache = NULL;
+    entry->after.cache = NULL;
+    entry->chain = *bucket;
+    *bucket = i;
+    memo_push(memo, i);
+
+    return rc;
+}
+
+double
+memo_hit_rate(const struct memo* memo)
+{
+    assert(memo != NULL);
+
+    if (memo->stats.lookups == 0) return 0;
+    return (double)memo->stats.hits / memo->stats.lookups;
+}
+
+void
+memo_free(struct memo* memo)
+{
+    assert(memo != NULL);
+
+    free(memo->entries);
+    free(memo->buckets);
+    memo->entries = NULL;
+    memo->buckets = NULL;
+}
+
+const char*
+memo_error_message(int error)
+{
+    switch (error) {
+    case MEMO_OK: return "OK";
+    case MEMO_ERROR_ALLOC: return "failed to allocate memory";
+    default: return "unknown error";
+    }
+}
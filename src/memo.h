@@ -0,0 +1,57 @@
+#ifndef SKYLARK_MEMO_H_INCLUDED
+#define SKYLARK_MEMO_H_INCLUDED
+
+#include <stdint.h>
+
+#include "chip8.h"
+
+enum memo_status {
+    MEMO_OK = 0,
+    MEMO_ERROR_ALLOC,
+};
+
+// A remembered frame: the state it started from, the keys held during
+// it, and the state and status it ended with. Entries sit on a hash
+// chain and on a doubly linked LRU list, both by index.
+struct memo_entry {
+    uint64_t hash;
+    uint16_t input;
+    int rc;
+    long chain;
+    long newer;
+    long older;
+    struct chip8 before;
+    struct chip8 after;
+};
+
+struct memo_stats {
+    long lookups;
+    long hits;
+    long misses;
+    long collisions;
+    long evictions;
+    long bypassed;
+};
+
+// Frames are keyed by chip8_hash plus the input mask, and a hit is only
+// taken once the stored start state compares equal, so a hash collision
+// costs a miss rather than a wrong frame. Machines with XO-CHIP extended
+// memory always run their frames directly.
+struct memo {
+    struct memo_entry* entries;
+    long capacity;
+    long count;
+    long* buckets;
+    long bucket_mask;
+    long newest;
+    long oldest;
+    struct memo_stats stats;
+};
+
+int memo_init(struct memo* memo, long capacity);
+int memo_frame(struct memo* memo, struct chip8* chip8);
+double memo_hit_rate(const struct memo* memo);
+void memo_free(struct memo* memo);
+const char* memo_error_message(int error);
+
+#endif
@@ -0,0 +1,51 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "memo.c"
+
+bool
+test_memo_frame(void)
+{
+    // a menu that loops waiting for a key
+    const uint8_t rom[] = {
+        0xf1, 0x0a,  // 200: LD V1, K
+        0x12, 0x00,  // 202: JP 200
+    };
+
+    struct memo memo;
+    if (memo_init(&memo, 2) != MEMO_OK) {
+        fprintf(stderr, "failed to init memo\n");
+        return false;
+    }
+
+    struct chip8 plain = { 0 };
+    struct chip8 memoized = { 0 };
+    chip8_init(&plain);
+    chip8_load(&plain, rom, sizeof(rom));
+    chip8_copy(&memoized, &plain);
+
+    bool ok = true;
+    for (long frame = 0; frame < 40 && ok; frame++) {
+        // idle at first, then cycle through more keys than the memo holds
+        uint16_t input = frame < 10 ? 0 : 1 << (frame % 3);
+        chip8_set_input(&plain, input);
+        chip8_set_input(&memoized, input);
+
+        int rc = chip8_frame(&plain);
+        if (memo_frame(&memo, &memoized) != rc || chip8_hash(&plain) != chip8_hash(&memoized)) {
+            fprintf(stderr, "memoized frame %ld diverged\n", frame);
+            ok = false;
+        }
+    }
+
+    if (ok && (memo.stats.hits < 9 || memo.stats.evictions == 0 || memo.count > memo.capacity)) {
+        fprintf(stderr, "memo had %ld hits and %ld evictions\n", memo.stats.hits, memo.stats.evictions);
+        ok = false;
+    }
+
+    memo_free(&memo);
+    return ok;
+}
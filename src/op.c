@@ -2,11 +2,40 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "cache.h"
 #include "chip8.h"
 #include "inst.h"
 #include "op.h"
 
 typedef int (*operation_func)(struct chip8* chip8, const struct instruction* inst);
+typedef int (*fusion_func)(struct chip8* chip8, const struct instruction* inst, long* count);
+
+// Called after every write to memory so that the guard region stays a mirror
+// of the start of memory. Writes that ran into the guard are folded back to
+// the start, and writes to the start are copied out to the guard. Since I
+// never exceeds the address mask, at most one of the two can apply.
+static inline void
+operation_written(struct chip8* chip8, long addr, long size)
+{
+    uint8_t* mem = chip8_memory(chip8);
+    long mem_size = chip8_addr_mask(chip8) + 1;
+    if (addr + size > mem_size) {
+        memcpy(mem, mem + mem_size, addr + size - mem_size);
+    } else if (addr < CHIP8_MEM_GUARD) {
+        memcpy(mem + mem_size, mem, CHIP8_MEM_GUARD);
+    }
+
+    if (chip8->cache != NULL && chip8->xmem == NULL) cache_invalidate(chip8->cache, addr, size);
+}
+
+// XO-CHIP skips step over the whole of a four byte F000 NNNN
+static inline void
+operation_skip(struct chip8* chip8)
+{
+    const uint8_t* mem = chip8_memory(chip8);
+    uint16_t next = (chip8->pc + 2) & chip8_addr_mask(chip8);
+    chip8->pc += (mem[next] == 0xf0 && mem[next + 1] == 0x00) ? 4 : 2;
+}
 
 static int
 operation_UNDEFINED(struct chip8* chip8, const struct instruction* inst)
@@ -17,7 +46,10 @@ operation_UNDEFINED(struct chip8* chip8, const struct instruction* inst)
 static int
 operation_CLS_00E0(struct chip8* chip8, const struct instruction* inst)
 {
-    memset(chip8->display, 0, sizeof(chip8->display));
+    // only the selected planes are cleared
+    for (long p = 0; p < CHIP8_PLANES; p++) {
+        if (chip8->planes & (1 << p)) memset(chip8->display[p], 0, sizeof(chip8->display[p]));
+    }
     chip8->pc += 2;
     return OPERATION_OK;
 }
@@ -29,6 +61,81 @@ operation_RET_00EE(struct chip8* chip8, const struct instruction* inst)
 
     chip8->sp -= 1;
     chip8->pc = chip8->stack[chip8->sp];
+    chip8->pc = (chip8->pc + 2) & chip8_addr_mask(chip8);
+    return OPERATION_OK;
+}
+
+static int
+operation_SCD_00Cn(struct chip8* chip8, const struct instruction* inst)
+{
+    // scrolling down is a move of whole rows in each selected plane
+    long height = chip8_display_height(chip8);
+    long n = inst->n < height ? inst->n : height;
+    for (long p = 0; p < CHIP8_PLANES; p++) {
+        if (!(chip8->planes & (1 << p))) continue;
+        memmove(chip8->display[p][n], chip8->display[p][0], (height - n) * sizeof(chip8->display[p][0]));
+        memset(chip8->display[p][0], 0, n * sizeof(chip8->display[p][0]));
+    }
+    chip8->pc += 2;
+    return OPERATION_OK;
+}
+
+static int
+operation_SCR_00FB(struct chip8* chip8, const struct instruction* inst)
+{
+    // each word takes the bits shifted out of the word to its left
+    long words = chip8->hires ? CHIP8_DISPLAY_WORDS : 1;
+    for (long p = 0; p < CHIP8_PLANES; p++) {
+        if (!(chip8->planes & (1 << p))) continue;
+        for (long y = 0; y < chip8_display_height(chip8); y++) {
+            uint64_t* row = chip8->display[p][y];
+            for (long i = words - 1; i > 0; i--) row[i] = row[i] >> 4 | row[i - 1] << 60;
+            row[0] >>= 4;
+        }
+    }
+    chip8->pc += 2;
+    return OPERATION_OK;
+}
+
+static int
+operation_SCL_00FC(struct chip8* chip8, const struct instruction* inst)
+{
+    long words = chip8->hires ? CHIP8_DISPLAY_WORDS : 1;
+    for (long p = 0; p < CHIP8_PLANES; p++) {
+        if (!(chip8->planes & (1 << p))) continue;
+        for (long y = 0; y < chip8_display_height(chip8); y++) {
+            uint64_t* row = chip8->display[p][y];
+            for (long i = 0; i < words - 1; i++) row[i] = row[i] << 4 | row[i + 1] >> 60;
+            row[words - 1] <<= 4;
+        }
+    }
+    chip8->pc += 2;
+    return OPERATION_OK;
+}
+
+static int
+operation_EXIT_00FD(struct chip8* chip8, const struct instruction* inst)
+{
+    // no "pc += 2" here, so the machine halts by spinning in place
+    return OPERATION_OK;
+}
+
+static int
+operation_LOW_00FE(struct chip8* chip8, const struct instruction* inst)
+{
+    // switching resolution clears the display so low resolution only
+    // ever has pixels in its corner of the framebuffer
+    chip8->hires = false;
+    memset(chip8->display, 0, sizeof(chip8->display));
+    chip8->pc += 2;
+    return OPERATION_OK;
+}
+
+static int
+operation_HIGH_00FF(struct chip8* chip8, const struct instruction* inst)
+{
+    chip8->hires = true;
+    memset(chip8->display, 0, sizeof(chip8->display));
     chip8->pc += 2;
     return OPERATION_OK;
 }
@@ -61,7 +168,7 @@ operation_CALL_2nnn(struct chip8* chip8, const struct instruction* inst)
 static int
 operation_SE_3xkk(struct chip8* chip8, const struct instruction* inst)
 {
-    if (chip8->reg[inst->x] == inst->kk) chip8->pc += 2;
+    if (chip8->reg[inst->x] == inst->kk) operation_skip(chip8);
     chip8->pc += 2;
     return OPERATION_OK;
 }
@@ -69,7 +176,7 @@ operation_SE_3xkk(struct chip8* chip8, const struct instruction* inst)
 static int
 operation_SNE_4xkk(struct chip8* chip8, const struct instruction* inst)
 {
-    if (chip8->reg[inst->x] != inst->kk) chip8->pc += 2;
+    if (chip8->reg[inst->x] != inst->kk) operation_skip(chip8);
     chip8->pc += 2;
     return OPERATION_OK;
 }
@@ -77,7 +184,35 @@ operation_SNE_4xkk(struct chip8* chip8, const struct instruction* inst)
 static int
 operation_SE_5xy0(struct chip8* chip8, const struct instruction* inst)
 {
-    if (chip8->reg[inst->x] == chip8->reg[inst->y]) chip8->pc += 2;
+    if (chip8->reg[inst->x] == chip8->reg[inst->y]) operation_skip(chip8);
+    chip8->pc += 2;
+    return OPERATION_OK;
+}
+
+static int
+operation_LD_5xy2(struct chip8* chip8, const struct instruction* inst)
+{
+    // registers are stored in the order given, which may be descending
+    uint8_t* mem = chip8_memory(chip8);
+    long step = inst->x <= inst->y ? 1 : -1;
+    long count = labs(inst->y - inst->x) + 1;
+    for (long i = 0; i < count; i++) {
+        mem[chip8->index + i] = chip8->reg[inst->x + i * step];
+    }
+    operation_written(chip8, chip8->index, count);
+    chip8->pc += 2;
+    return OPERATION_OK;
+}
+
+static int
+operation_LD_5xy3(struct chip8* chip8, const struct instruction* inst)
+{
+    const uint8_t* mem = chip8_memory(chip8);
+    long step = inst->x <= inst->y ? 1 : -1;
+    long count = labs(inst->y - inst->x) + 1;
+    for (long i = 0; i < count; i++) {
+        chip8->reg[inst->x + i * step] = mem[chip8->index + i];
+    }
     chip8->pc += 2;
     return OPERATION_OK;
 }
@@ -106,26 +241,29 @@ operation_LD_8xy0(struct chip8* chip8, const struct instruction* inst)
     return OPERATION_OK;
 }
 
-static int
-operation_OR_8xy1(struct chip8* chip8, const struct instruction* inst)
+static inline int
+operation_OR_8xy1(struct chip8* chip8, const struct instruction* inst, int quirks)
 {
     chip8->reg[inst->x] |= chip8->reg[inst->y];
+    if (quirks & CHIP8_QUIRK_LOGIC_RESET_VF) chip8->reg[CHIP8_REG_VF] = 0;
     chip8->pc += 2;
     return OPERATION_OK;
 }
 
-static int
-operation_AND_8xy2(struct chip8* chip8, const struct instruction* inst)
+static inline int
+operation_AND_8xy2(struct chip8* chip8, const struct instruction* inst, int quirks)
 {
     chip8->reg[inst->x] &= chip8->reg[inst->y];
+    if (quirks & CHIP8_QUIRK_LOGIC_RESET_VF) chip8->reg[CHIP8_REG_VF] = 0;
     chip8->pc += 2;
     return OPERATION_OK;
 }
 
-static int
-operation_XOR_8xy3(struct chip8* chip8, const struct instruction* inst)
+static inline int
+operation_XOR_8xy3(struct chip8* chip8, const struct instruction* inst, int quirks)
 {
     chip8->reg[inst->x] ^= chip8->reg[inst->y];
+    if (quirks & CHIP8_QUIRK_LOGIC_RESET_VF) chip8->reg[CHIP8_REG_VF] = 0;
     chip8->pc += 2;
     return OPERATION_OK;
 }
@@ -148,11 +286,12 @@ operation_SUB_8xy5(struct chip8* chip8, const struct instruction* inst)
     return OPERATION_OK;
 }
 
-static int
-operation_SHR_8xy6(struct chip8* chip8, const struct instruction* inst)
+static inline int
+operation_SHR_8xy6(struct chip8* chip8, const struct instruction* inst, int quirks)
 {
-    chip8->reg[CHIP8_REG_VF] = (chip8->reg[inst->x] & 0x1) ? 1 : 0;
-    chip8->reg[inst->x] >>= 1;
+    uint8_t value = chip8->reg[(quirks & CHIP8_QUIRK_SHIFT_VY) ? inst->y : inst->x];
+    chip8->reg[inst->x] = value >> 1;
+    chip8->reg[CHIP8_REG_VF] = value & 0x1;
     chip8->pc += 2;
     return OPERATION_OK;
 }
@@ -166,11 +305,12 @@ operation_SUBN_8xy7(struct chip8* chip8, const struct instruction* inst)
     return OPERATION_OK;
 }
 
-static int
-operation_SHL_8xyE(struct chip8* chip8, const struct instruction* inst)
+static inline int
+operation_SHL_8xyE(struct chip8* chip8, const struct instruction* inst, int quirks)
 {
-    chip8->reg[CHIP8_REG_VF] = (chip8->reg[inst->x] & 0x8) ? 1 : 0;
-    chip8->reg[inst->x] <<= 1;
+    uint8_t value = chip8->reg[(quirks & CHIP8_QUIRK_SHIFT_VY) ? inst->y : inst->x];
+    chip8->reg[inst->x] = value << 1;
+    chip8->reg[CHIP8_REG_VF] = (value & 0x80) ? 1 : 0;
     chip8->pc += 2;
     return OPERATION_OK;
 }
@@ -178,7 +318,7 @@ operation_SHL_8xyE(struct chip8* chip8, const struct instruction* inst)
 static int
 operation_SNE_9xy0(struct chip8* chip8, const struct instruction* inst)
 {
-    if (chip8->reg[inst->x] != chip8->reg[inst->y]) chip8->pc += 2;
+    if (chip8->reg[inst->x] != chip8->reg[inst->y]) operation_skip(chip8);
     chip8->pc += 2;
     return OPERATION_OK;
 }
@@ -191,54 +331,118 @@ operation_LD_Annn(struct chip8* chip8, const struct instruction* inst)
     return OPERATION_OK;
 }
 
-static int
-operation_JP_Bnnn(struct chip8* chip8, const struct instruction* inst)
+static inline int
+operation_JP_Bnnn(struct chip8* chip8, const struct instruction* inst, int quirks)
 {
-    chip8->pc = inst->nnn + chip8->reg[CHIP8_REG_V0];
+    // SUPER-CHIP reads this as Bxnn: jump to xnn plus Vx
+    long reg = (quirks & CHIP8_QUIRK_JUMP_VX) ? inst->x : CHIP8_REG_V0;
+    chip8->pc = (inst->nnn + chip8->reg[reg]) & chip8_addr_mask(chip8);
     return OPERATION_OK;
 }
 
 static int
 operation_RND_Cxkk(struct chip8* chip8, const struct instruction* inst)
 {
-    chip8->reg[inst->x] = rand() & inst->kk;
+    // xorshift32, which never leaves a nonzero state
+    uint32_t rng = chip8->rng;
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    chip8->rng = rng;
+
+    chip8->reg[inst->x] = (rng >> 24) & inst->kk;
     chip8->pc += 2;
     return OPERATION_OK;
 }
 
-static int
-operation_DRW_Dxyn(struct chip8* chip8, const struct instruction* inst)
+// XOR one sprite row into a display row. The sprite bits are left-aligned,
+// so they land in at most two words, and whatever runs past the right edge
+// either wraps to the first word or is clipped. Returns true on a collision.
+static inline bool
+operation_draw_row(uint64_t* row, long words, long x, uint64_t bits, int quirks)
 {
-    chip8->reg[CHIP8_REG_VF] = 0;
-    for (long dy = 0; dy < inst->n; dy++) {
-        uint8_t sprite = chip8->mem[chip8->index + dy];
-        for (long dx = 0; dx < CHIP8_SPRITE_WIDTH; dx++) {
-            // account for pixels wrapping around edges of the display
-            long x = (chip8->reg[inst->x] + dx) % CHIP8_DISPLAY_WIDTH;
-            long y = (chip8->reg[inst->y] + dy) % CHIP8_DISPLAY_HEIGHT;
-
-            // chip8->display is stored as a row-major matrix
-            long pixel_index = (y * CHIP8_DISPLAY_WIDTH) + x;
+    long i = x / 64;
+    long shift = x % 64;
 
-            // determine what the resulting pixel value will be
-            bool new_pixel = sprite & (0x80 >> dx);
-            bool old_pixel = chip8->display[pixel_index];
-            bool resulting_pixel = new_pixel ^ old_pixel;
+    uint64_t part = bits >> shift;
+    bool collision = row[i] & part;
+    row[i] ^= part;
 
-            // set VF register to 1 if a pixel gets turned off
-            if (old_pixel && !resulting_pixel) chip8->reg[CHIP8_REG_VF] = 1;
+    uint64_t spill = shift > 0 ? bits << (64 - shift) : 0;
+    if (spill == 0) return collision;
 
-            chip8->display[pixel_index] = resulting_pixel;
+    i += 1;
+    if (i == words) {
+        if (quirks & CHIP8_QUIRK_DRAW_CLIP) return collision;
+        i = 0;
+    }
+    collision |= (row[i] & spill) != 0;
+    row[i] ^= spill;
+    return collision;
+}
+
+static inline int
+operation_draw(struct chip8* chip8, const struct instruction* inst, long rows, long width, int quirks)
+{
+    long words = chip8->hires ? CHIP8_DISPLAY_WORDS : 1;
+    long height = chip8_display_height(chip8);
+    long x = chip8->reg[inst->x] % (words * 64);
+    long y = chip8->reg[inst->y] % height;
+
+    // each selected plane takes the next sprite in memory, so with both
+    // planes selected the sprite data is twice as long
+    const uint8_t* mem = chip8_memory(chip8);
+    uint16_t mask = chip8_addr_mask(chip8);
+    uint16_t addr = chip8->index;
+
+    bool collision = false;
+    for (long p = 0; p < CHIP8_PLANES; p++) {
+        if (!(chip8->planes & (1 << p))) continue;
+
+        for (long dy = 0; dy < rows; dy++) {
+            // either clip or wrap rows that fall past the bottom of the display
+            long row = y + dy;
+            if (row >= height) {
+                if (quirks & CHIP8_QUIRK_DRAW_CLIP) break;
+                row -= height;
+            }
+
+            uint64_t bits = 0;
+            if (width == CHIP8_BIG_SPRITE_SIZE) {
+                uint16_t at = (addr + dy * 2) & mask;
+                bits = (uint64_t)(mem[at] << 8 | mem[at + 1]) << 48;
+            } else {
+                bits = (uint64_t)mem[(addr + dy) & mask] << 56;
+            }
+
+            collision |= operation_draw_row(chip8->display[p][row], words, x, bits, quirks);
         }
+        addr += rows * (width / 8);
     }
+
+    // set VF register to 1 if any pixel gets turned off
+    chip8->reg[CHIP8_REG_VF] = collision;
     chip8->pc += 2;
     return OPERATION_OK;
 }
 
+static inline int
+operation_DRW_Dxy0(struct chip8* chip8, const struct instruction* inst, int quirks)
+{
+    return operation_draw(chip8, inst, CHIP8_BIG_SPRITE_SIZE, CHIP8_BIG_SPRITE_SIZE, quirks);
+}
+
+static inline int
+operation_DRW_Dxyn(struct chip8* chip8, const struct instruction* inst, int quirks)
+{
+    return operation_draw(chip8, inst, inst->n, CHIP8_SPRITE_WIDTH, quirks);
+}
+
 static int
 operation_SKP_Ex9E(struct chip8* chip8, const struct instruction* inst)
 {
-    if (chip8->input[chip8->reg[inst->x]]) chip8->pc += 2;
+    // only the low nibble names a key, as on the original interpreter
+    if (chip8->input[chip8->reg[inst->x] & 0xf]) operation_skip(chip8);
     chip8->pc += 2;
     return OPERATION_OK;
 }
@@ -246,7 +450,42 @@ operation_SKP_Ex9E(struct chip8* chip8, const struct instruction* inst)
 static int
 operation_SKNP_ExA1(struct chip8* chip8, const struct instruction* inst)
 {
-    if (!chip8->input[chip8->reg[inst->x]]) chip8->pc += 2;
+    if (!chip8->input[chip8->reg[inst->x] & 0xf]) operation_skip(chip8);
+    chip8->pc += 2;
+    return OPERATION_OK;
+}
+
+static int
+operation_LD_F000(struct chip8* chip8, const struct instruction* inst)
+{
+    // the address is the whole of the following word
+    const uint8_t* mem = chip8_memory(chip8);
+    uint16_t at = (chip8->pc + 2) & chip8_addr_mask(chip8);
+    uint16_t addr = mem[at] << 8 | mem[at + 1];
+
+    // addresses past classic memory are what switch a machine to 64K
+    if (addr > CHIP8_ADDR_MASK && chip8->xmem == NULL) {
+        if (chip8_extend(chip8) != CHIP8_OK) return OPERATION_ERROR_OUT_OF_MEMORY;
+    }
+
+    chip8->index = addr;
+    chip8->pc += 4;
+    return OPERATION_OK;
+}
+
+static int
+operation_PLANE_Fn01(struct chip8* chip8, const struct instruction* inst)
+{
+    chip8->planes = inst->x & ((1 << CHIP8_PLANES) - 1);
+    chip8->pc += 2;
+    return OPERATION_OK;
+}
+
+static int
+operation_AUDIO_F002(struct chip8* chip8, const struct instruction* inst)
+{
+    const uint8_t* mem = chip8_memory(chip8);
+    memcpy(chip8->audio, mem + chip8->index, CHIP8_AUDIO_SIZE);
     chip8->pc += 2;
     return OPERATION_OK;
 }
@@ -293,7 +532,7 @@ operation_LD_Fx18(struct chip8* chip8, const struct instruction* inst)
 static int
 operation_ADD_Fx1E(struct chip8* chip8, const struct instruction* inst)
 {
-    chip8->index += chip8->reg[inst->x];
+    chip8->index = (chip8->index + chip8->reg[inst->x]) & chip8_addr_mask(chip8);
     chip8->pc += 2;
     return OPERATION_OK;
 }
@@ -306,73 +545,240 @@ operation_LD_Fx29(struct chip8* chip8, const struct instruction* inst)
     return OPERATION_OK;
 }
 
+static int
+operation_LD_Fx30(struct chip8* chip8, const struct instruction* inst)
+{
+    chip8->index = CHIP8_BIG_FONT_ADDR + (chip8->reg[inst->x] & 0xf) * CHIP8_BIG_FONT_SIZE;
+    chip8->pc += 2;
+    return OPERATION_OK;
+}
+
 static int
 operation_LD_Fx33(struct chip8* chip8, const struct instruction* inst)
 {
-    chip8->mem[chip8->index + 0] = (chip8->reg[inst->x] / 100);
-    chip8->mem[chip8->index + 1] = (chip8->reg[inst->x] / 10)  % 10;
-    chip8->mem[chip8->index + 2] = (chip8->reg[inst->x] / 100) % 10;
+    uint8_t* mem = chip8_memory(chip8);
+    mem[chip8->index + 0] = (chip8->reg[inst->x] / 100);
+    mem[chip8->index + 1] = (chip8->reg[inst->x] / 10) % 10;
+    mem[chip8->index + 2] = (chip8->reg[inst->x] % 10);
+    operation_written(chip8, chip8->index, 3);
     chip8->pc += 2;
     return OPERATION_OK;
 }
 
 static int
-operation_LD_Fx55(struct chip8* chip8, const struct instruction* inst)
+operation_LD_Fx3A(struct chip8* chip8, const struct instruction* inst)
+{
+    chip8->pitch = chip8->reg[inst->x];
+    chip8->pc += 2;
+    return OPERATION_OK;
+}
+
+static inline int
+operation_LD_Fx55(struct chip8* chip8, const struct instruction* inst, int quirks)
+{
+    uint8_t* mem = chip8_memory(chip8);
+    for (long i = 0; i <= inst->x; i++) {
+        mem[chip8->index + i] = chip8->reg[i];
+    }
+    operation_written(chip8, chip8->index, inst->x + 1);
+    if (quirks & CHIP8_QUIRK_MEMORY_INCREMENT) chip8->index = (chip8->index + inst->x + 1) & chip8_addr_mask(chip8);
+    chip8->pc += 2;
+    return OPERATION_OK;
+}
+
+static inline int
+operation_LD_Fx65(struct chip8* chip8, const struct instruction* inst, int quirks)
 {
-    for (long i = 0; i < inst->x; i++) {
-        chip8->mem[chip8->index + i] = chip8->reg[i];
+    const uint8_t* mem = chip8_memory(chip8);
+    for (long i = 0; i <= inst->x; i++) {
+        chip8->reg[i] = mem[chip8->index + i];
     }
+    if (quirks & CHIP8_QUIRK_MEMORY_INCREMENT) chip8->index = (chip8->index + inst->x + 1) & chip8_addr_mask(chip8);
+    chip8->pc += 2;
+    return OPERATION_OK;
+}
+
+static int
+operation_LD_Fx75(struct chip8* chip8, const struct instruction* inst)
+{
+    memcpy(chip8->rpl, chip8->reg, inst->x + 1);
     chip8->pc += 2;
     return OPERATION_OK;
 }
 
 static int
-operation_LD_Fx65(struct chip8* chip8, const struct instruction* inst)
+operation_LD_Fx85(struct chip8* chip8, const struct instruction* inst)
 {
-    for (long i = 0; i < inst->x; i++) {
-        chip8->reg[i] = chip8->mem[chip8->index + i];
+    memcpy(chip8->reg, chip8->rpl, inst->x + 1);
+    chip8->pc += 2;
+    return OPERATION_OK;
+}
+
+// Fused operations run a whole sequence of instructions for one dispatch.
+// The caller has already checked that inst holds the expected sequence,
+// and count reports how many of them actually executed.
+static inline int
+operation_LD_Annn_DRW_Dxyn(struct chip8* chip8, const struct instruction* inst, long* count, int quirks)
+{
+    operation_LD_Annn(chip8, &inst[0]);
+    *count = 2;
+    return operation_DRW_Dxyn(chip8, &inst[1], quirks);
+}
+
+static inline int
+operation_ADD_7xkk_SE_3xkk_JP_1nnn(struct chip8* chip8, const struct instruction* inst, long* count, int quirks)
+{
+    chip8->reg[inst[0].x] += inst[0].kk;
+
+    // a taken skip steps over the jump
+    if (chip8->reg[inst[1].x] == inst[1].kk) {
+        chip8->pc += 6;
+        *count = 2;
+        return OPERATION_OK;
     }
+
+    chip8->pc = inst[2].nnn;
+    *count = 3;
+    return OPERATION_OK;
+}
+
+static inline int
+operation_LD_Fx07_SE_3xkk(struct chip8* chip8, const struct instruction* inst, long* count, int quirks)
+{
+    chip8->reg[inst[0].x] = chip8->timer_delay;
+    chip8->pc += 2;
+    if (chip8->reg[inst[1].x] == inst[1].kk) operation_skip(chip8);
     chip8->pc += 2;
+    *count = 2;
     return OPERATION_OK;
 }
 
-static operation_func OPERATIONS[] = {
-    [OPCODE_UNDEFINED] = operation_UNDEFINED,
-    [OPCODE_CLS_00E0] = operation_CLS_00E0,
-    [OPCODE_RET_00EE] = operation_RET_00EE,
-    [OPCODE_SYS_0nnn] = operation_SYS_0nnn,
-    [OPCODE_JP_1nnn] = operation_JP_1nnn,
-    [OPCODE_CALL_2nnn] = operation_CALL_2nnn,
-    [OPCODE_SE_3xkk] = operation_SE_3xkk,
-    [OPCODE_SNE_4xkk] = operation_SNE_4xkk,
-    [OPCODE_SE_5xy0] = operation_SE_5xy0,
-    [OPCODE_LD_6xkk] = operation_LD_6xkk,
-    [OPCODE_ADD_7xkk] = operation_ADD_7xkk,
-    [OPCODE_LD_8xy0] = operation_LD_8xy0,
-    [OPCODE_OR_8xy1] = operation_OR_8xy1,
-    [OPCODE_AND_8xy2] = operation_AND_8xy2,
-    [OPCODE_XOR_8xy3] = operation_XOR_8xy3,
-    [OPCODE_ADD_8xy4] = operation_ADD_8xy4,
-    [OPCODE_SUB_8xy5] = operation_SUB_8xy5,
-    [OPCODE_SHR_8xy6] = operation_SHR_8xy6,
-    [OPCODE_SUBN_8xy7] = operation_SUBN_8xy7,
-    [OPCODE_SHL_8xyE] = operation_SHL_8xyE,
-    [OPCODE_SNE_9xy0] = operation_SNE_9xy0,
-    [OPCODE_LD_Annn] = operation_LD_Annn,
-    [OPCODE_JP_Bnnn] = operation_JP_Bnnn,
-    [OPCODE_RND_Cxkk] = operation_RND_Cxkk,
-    [OPCODE_DRW_Dxyn] = operation_DRW_Dxyn,
-    [OPCODE_SKP_Ex9E] = operation_SKP_Ex9E,
-    [OPCODE_SKNP_ExA1] = operation_SKNP_ExA1,
-    [OPCODE_LD_Fx07] = operation_LD_Fx07,
-    [OPCODE_LD_Fx0A] = operation_LD_Fx0A,
-    [OPCODE_LD_Fx15] = operation_LD_Fx15,
-    [OPCODE_LD_Fx18] = operation_LD_Fx18,
-    [OPCODE_ADD_Fx1E] = operation_ADD_Fx1E,
-    [OPCODE_LD_Fx29] = operation_LD_Fx29,
-    [OPCODE_LD_Fx33] = operation_LD_Fx33,
-    [OPCODE_LD_Fx55] = operation_LD_Fx55,
-    [OPCODE_LD_Fx65] = operation_LD_Fx65,
+static int
+operation_fused_UNDEFINED(struct chip8* chip8, const struct instruction* inst, long* count)
+{
+    return OPERATION_ERROR_UNDEFINED_OPERATION;
+}
+
+// Every quirk profile gets its own copy of the quirk-sensitive operations
+// with the profile folded in as a constant, so quirks are never tested at
+// runtime. The profile then simply selects which table is dispatched from.
+#define OPERATION_PROFILE(q)                                                                                                \
+    static int operation_OR_8xy1_##q(struct chip8* c, const struct instruction* i)  { return operation_OR_8xy1(c, i, q); }  \
+    static int operation_AND_8xy2_##q(struct chip8* c, const struct instruction* i) { return operation_AND_8xy2(c, i, q); } \
+    static int operation_XOR_8xy3_##q(struct chip8* c, const struct instruction* i) { return operation_XOR_8xy3(c, i, q); } \
+    static int operation_SHR_8xy6_##q(struct chip8* c, const struct instruction* i) { return operation_SHR_8xy6(c, i, q); } \
+    static int operation_SHL_8xyE_##q(struct chip8* c, const struct instruction* i) { return operation_SHL_8xyE(c, i, q); } \
+    static int operation_JP_Bnnn_##q(struct chip8* c, const struct instruction* i)  { return operation_JP_Bnnn(c, i, q); }  \
+    static int operation_DRW_Dxy0_##q(struct chip8* c, const struct instruction* i) { return operation_DRW_Dxy0(c, i, q); } \
+    static int operation_DRW_Dxyn_##q(struct chip8* c, const struct instruction* i) { return operation_DRW_Dxyn(c, i, q); } \
+    static int operation_LD_Fx55_##q(struct chip8* c, const struct instruction* i)  { return operation_LD_Fx55(c, i, q); }  \
+    static int operation_LD_Fx65_##q(struct chip8* c, const struct instruction* i)  { return operation_LD_Fx65(c, i, q); }
+
+#define FUSION_PROFILE(q)                                                                                                                                               \
+    static int operation_LD_Annn_DRW_Dxyn_##q(struct chip8* c, const struct instruction* i, long* n) { return operation_LD_Annn_DRW_Dxyn(c, i, n, q); }                 \
+    static int operation_ADD_7xkk_SE_3xkk_JP_1nnn_##q(struct chip8* c, const struct instruction* i, long* n) { return operation_ADD_7xkk_SE_3xkk_JP_1nnn(c, i, n, q); } \
+    static int operation_LD_Fx07_SE_3xkk_##q(struct chip8* c, const struct instruction* i, long* n) { return operation_LD_Fx07_SE_3xkk(c, i, n, q); }
+
+#define OPERATION_TABLE(q) {                    \
+    [OPCODE_UNDEFINED] = operation_UNDEFINED,   \
+    [OPCODE_CLS_00E0] = operation_CLS_00E0,     \
+    [OPCODE_RET_00EE] = operation_RET_00EE,     \
+    [OPCODE_SCD_00Cn] = operation_SCD_00Cn,     \
+    [OPCODE_SCR_00FB] = operation_SCR_00FB,     \
+    [OPCODE_SCL_00FC] = operation_SCL_00FC,     \
+    [OPCODE_EXIT_00FD] = operation_EXIT_00FD,   \
+    [OPCODE_LOW_00FE] = operation_LOW_00FE,     \
+    [OPCODE_HIGH_00FF] = operation_HIGH_00FF,   \
+    [OPCODE_SYS_0nnn] = operation_SYS_0nnn,     \
+    [OPCODE_JP_1nnn] = operation_JP_1nnn,       \
+    [OPCODE_CALL_2nnn] = operation_CALL_2nnn,   \
+    [OPCODE_SE_3xkk] = operation_SE_3xkk,       \
+    [OPCODE_SNE_4xkk] = operation_SNE_4xkk,     \
+    [OPCODE_SE_5xy0] = operation_SE_5xy0,       \
+    [OPCODE_LD_5xy2] = operation_LD_5xy2,       \
+    [OPCODE_LD_5xy3] = operation_LD_5xy3,       \
+    [OPCODE_LD_6xkk] = operation_LD_6xkk,       \
+    [OPCODE_ADD_7xkk] = operation_ADD_7xkk,     \
+    [OPCODE_LD_8xy0] = operation_LD_8xy0,       \
+    [OPCODE_OR_8xy1] = operation_OR_8xy1_##q,   \
+    [OPCODE_AND_8xy2] = operation_AND_8xy2_##q, \
+    [OPCODE_XOR_8xy3] = operation_XOR_8xy3_##q, \
+    [OPCODE_ADD_8xy4] = operation_ADD_8xy4,     \
+    [OPCODE_SUB_8xy5] = operation_SUB_8xy5,     \
+    [OPCODE_SHR_8xy6] = operation_SHR_8xy6_##q, \
+    [OPCODE_SUBN_8xy7] = operation_SUBN_8xy7,   \
+    [OPCODE_SHL_8xyE] = operation_SHL_8xyE_##q, \
+    [OPCODE_SNE_9xy0] = operation_SNE_9xy0,     \
+    [OPCODE_LD_Annn] = operation_LD_Annn,       \
+    [OPCODE_JP_Bnnn] = operation_JP_Bnnn_##q,   \
+    [OPCODE_RND_Cxkk] = operation_RND_Cxkk,     \
+    [OPCODE_DRW_Dxy0] = operation_DRW_Dxy0_##q, \
+    [OPCODE_DRW_Dxyn] = operation_DRW_Dxyn_##q, \
+    [OPCODE_SKP_Ex9E] = operation_SKP_Ex9E,     \
+    [OPCODE_SKNP_ExA1] = operation_SKNP_ExA1,   \
+    [OPCODE_LD_F000] = operation_LD_F000,       \
+    [OPCODE_PLANE_Fn01] = operation_PLANE_Fn01, \
+    [OPCODE_AUDIO_F002] = operation_AUDIO_F002, \
+    [OPCODE_LD_Fx07] = operation_LD_Fx07,       \
+    [OPCODE_LD_Fx0A] = operation_LD_Fx0A,       \
+    [OPCODE_LD_Fx15] = operation_LD_Fx15,       \
+    [OPCODE_LD_Fx18] = operation_LD_Fx18,       \
+    [OPCODE_ADD_Fx1E] = operation_ADD_Fx1E,     \
+    [OPCODE_LD_Fx29] = operation_LD_Fx29,       \
+    [OPCODE_LD_Fx30] = operation_LD_Fx30,       \
+    [OPCODE_LD_Fx33] = operation_LD_Fx33,       \
+    [OPCODE_LD_Fx3A] = operation_LD_Fx3A,       \
+    [OPCODE_LD_Fx55] = operation_LD_Fx55_##q,   \
+    [OPCODE_LD_Fx65] = operation_LD_Fx65_##q,   \
+    [OPCODE_LD_Fx75] = operation_LD_Fx75,       \
+    [OPCODE_LD_Fx85] = operation_LD_Fx85,       \
+}
+
+#define FUSION_TABLE(q) {                                                       \
+    [FUSION_NONE] = operation_fused_UNDEFINED,                                  \
+    [FUSION_LD_Annn_DRW_Dxyn] = operation_LD_Annn_DRW_Dxyn_##q,                 \
+    [FUSION_ADD_7xkk_SE_3xkk_JP_1nnn] = operation_ADD_7xkk_SE_3xkk_JP_1nnn_##q, \
+    [FUSION_LD_Fx07_SE_3xkk] = operation_LD_Fx07_SE_3xkk_##q,                   \
+}
+
+OPERATION_PROFILE(0)  OPERATION_PROFILE(1)  OPERATION_PROFILE(2)  OPERATION_PROFILE(3)
+OPERATION_PROFILE(4)  OPERATION_PROFILE(5)  OPERATION_PROFILE(6)  OPERATION_PROFILE(7)
+OPERATION_PROFILE(8)  OPERATION_PROFILE(9)  OPERATION_PROFILE(10) OPERATION_PROFILE(11)
+OPERATION_PROFILE(12) OPERATION_PROFILE(13) OPERATION_PROFILE(14) OPERATION_PROFILE(15)
+OPERATION_PROFILE(16) OPERATION_PROFILE(17) OPERATION_PROFILE(18) OPERATION_PROFILE(19)
+OPERATION_PROFILE(20) OPERATION_PROFILE(21) OPERATION_PROFILE(22) OPERATION_PROFILE(23)
+OPERATION_PROFILE(24) OPERATION_PROFILE(25) OPERATION_PROFILE(26) OPERATION_PROFILE(27)
+OPERATION_PROFILE(28) OPERATION_PROFILE(29) OPERATION_PROFILE(30) OPERATION_PROFILE(31)
+
+FUSION_PROFILE(0)  FUSION_PROFILE(1)  FUSION_PROFILE(2)  FUSION_PROFILE(3)
+FUSION_PROFILE(4)  FUSION_PROFILE(5)  FUSION_PROFILE(6)  FUSION_PROFILE(7)
+FUSION_PROFILE(8)  FUSION_PROFILE(9)  FUSION_PROFILE(10) FUSION_PROFILE(11)
+FUSION_PROFILE(12) FUSION_PROFILE(13) FUSION_PROFILE(14) FUSION_PROFILE(15)
+FUSION_PROFILE(16) FUSION_PROFILE(17) FUSION_PROFILE(18) FUSION_PROFILE(19)
+FUSION_PROFILE(20) FUSION_PROFILE(21) FUSION_PROFILE(22) FUSION_PROFILE(23)
+FUSION_PROFILE(24) FUSION_PROFILE(25) FUSION_PROFILE(26) FUSION_PROFILE(27)
+FUSION_PROFILE(28) FUSION_PROFILE(29) FUSION_PROFILE(30) FUSION_PROFILE(31)
+
+static const operation_func OPERATIONS[CHIP8_QUIRK_COUNT][OPCODE_COUNT] = {
+    OPERATION_TABLE(0),  OPERATION_TABLE(1),  OPERATION_TABLE(2),  OPERATION_TABLE(3),
+    OPERATION_TABLE(4),  OPERATION_TABLE(5),  OPERATION_TABLE(6),  OPERATION_TABLE(7),
+    OPERATION_TABLE(8),  OPERATION_TABLE(9),  OPERATION_TABLE(10), OPERATION_TABLE(11),
+    OPERATION_TABLE(12), OPERATION_TABLE(13), OPERATION_TABLE(14), OPERATION_TABLE(15),
+    OPERATION_TABLE(16), OPERATION_TABLE(17), OPERATION_TABLE(18), OPERATION_TABLE(19),
+    OPERATION_TABLE(20), OPERATION_TABLE(21), OPERATION_TABLE(22), OPERATION_TABLE(23),
+    OPERATION_TABLE(24), OPERATION_TABLE(25), OPERATION_TABLE(26), OPERATION_TABLE(27),
+    OPERATION_TABLE(28), OPERATION_TABLE(29), OPERATION_TABLE(30), OPERATION_TABLE(31),
+};
+
+static const fusion_func FUSIONS[CHIP8_QUIRK_COUNT][FUSION_COUNT] = {
+    FUSION_TABLE(0),  FUSION_TABLE(1),  FUSION_TABLE(2),  FUSION_TABLE(3),
+    FUSION_TABLE(4),  FUSION_TABLE(5),  FUSION_TABLE(6),  FUSION_TABLE(7),
+    FUSION_TABLE(8),  FUSION_TABLE(9),  FUSION_TABLE(10), FUSION_TABLE(11),
+    FUSION_TABLE(12), FUSION_TABLE(13), FUSION_TABLE(14), FUSION_TABLE(15),
+    FUSION_TABLE(16), FUSION_TABLE(17), FUSION_TABLE(18), FUSION_TABLE(19),
+    FUSION_TABLE(20), FUSION_TABLE(21), FUSION_TABLE(22), FUSION_TABLE(23),
+    FUSION_TABLE(24), FUSION_TABLE(25), FUSION_TABLE(26), FUSION_TABLE(27),
+    FUSION_TABLE(28), FUSION_TABLE(29), FUSION_TABLE(30), FUSION_TABLE(31),
 };
 
 int
@@ -381,10 +787,21 @@ operation_apply(struct chip8* chip8, const struct instruction* inst)
     assert(chip8 != NULL);
     assert(inst != NULL);
 
-    operation_func operation = OPERATIONS[inst->opcode];
+    operation_func operation = OPERATIONS[chip8->quirks & CHIP8_QUIRK_MASK][inst->opcode];
     return operation(chip8, inst);
 }
 
+int
+operation_fused(struct chip8* chip8, int fusion, const struct instruction* inst, long* count)
+{
+    assert(chip8 != NULL);
+    assert(inst != NULL);
+    assert(count != NULL);
+
+    fusion_func operation = FUSIONS[chip8->quirks & CHIP8_QUIRK_MASK][fusion];
+    return operation(chip8, inst, count);
+}
+
 const char*
 operation_error_message(int error)
 {
@@ -394,6 +811,7 @@ operation_error_message(int error)
     case OPERATION_ERROR_UNDEFINED_OPERATION: return "undefined operation";
     case OPERATION_ERROR_STACK_OVERFLOW: return "stack overflow";
     case OPERATION_ERROR_STACK_UNDERFLOW: return "stack underflow";
+    case OPERATION_ERROR_OUT_OF_MEMORY: return "out of memory for XO-CHIP extended memory";
     default: return "unknown error";
     }
 }
@@ -10,9 +10,11 @@ enum operation_status {
     OPERATION_ERROR_UNDEFINED_OPERATION,
     OPERATION_ERROR_STACK_OVERFLOW,
     OPERATION_ERROR_STACK_UNDERFLOW,
+    OPERATION_ERROR_OUT_OF_MEMORY,
 };
 
 int operation_apply(struct chip8* chip8, const struct instruction* inst);
+int operation_fused(struct chip8* chip8, int fusion, const struct instruction* inst, long* count);
 const char* operation_error_message(int error);
 
 #endif
@@ -36,9 +36,8 @@ test_operation_CLS_00E0(void)
     };
 
     // manually turn on all pixels
-    for (long i = 0; i < CHIP8_DISPLAY_WIDTH * CHIP8_DISPLAY_HEIGHT; i++) {
-        chip8.display[i] = true;
-    }
+    chip8.hires = true;
+    memset(chip8.display[0], 0xff, sizeof(chip8.display[0]));
 
     uint16_t pc_before = chip8.pc;
     int rc = operation_CLS_00E0(&chip8, &inst);
@@ -47,10 +46,12 @@ test_operation_CLS_00E0(void)
         return false;
     }
 
-    for (long i = 0; i < CHIP8_DISPLAY_WIDTH * CHIP8_DISPLAY_HEIGHT; i++) {
-        if (chip8.display[i] == true) {
-            fprintf(stderr, "operation_CLS_00E0 failed to clear all pixels\n");
-            return false;
+    for (long y = 0; y < CHIP8_DISPLAY_HEIGHT; y++) {
+        for (long x = 0; x < CHIP8_DISPLAY_WIDTH; x++) {
+            if (chip8_pixel_on(&chip8, x, y)) {
+                fprintf(stderr, "operation_CLS_00E0 failed to clear all pixels\n");
+                return false;
+            }
         }
     }
 
@@ -150,3 +151,296 @@ test_operation_JP_1nnn(void)
 
     return true;
 }
+
+bool
+test_operation_SKP_Ex9E(void)
+{
+    struct chip8 chip8 = { 0 };
+    chip8_init(&chip8);
+    chip8.pc = 0x200;
+    chip8.reg[0] = 0x35;
+    chip8_set_input(&chip8, 1 << 5);
+
+    // a register past the last key must not index past the keypad
+    struct instruction inst = {
+        .opcode = OPCODE_SKP_Ex9E,
+        .x = 0,
+    };
+
+    int rc = operation_SKP_Ex9E(&chip8, &inst);
+    if (rc != OPERATION_OK || chip8.pc != 0x204) {
+        fprintf(stderr, "operation_SKP_Ex9E did not skip on key %x\n", chip8.reg[0] & 0xf);
+        return false;
+    }
+
+    return true;
+}
+
+bool
+test_operation_quirks(void)
+{
+    struct chip8 chip8 = { 0 };
+    chip8_init(&chip8);
+
+    struct instruction shr = {
+        .opcode = OPCODE_SHR_8xy6,
+        .x = 0x1,
+        .y = 0x2,
+    };
+
+    // the default profile shifts Vx in place
+    chip8.reg[1] = 0x04;
+    chip8.reg[2] = 0x03;
+    operation_apply(&chip8, &shr);
+    if (chip8.reg[1] != 0x02 || chip8.reg[CHIP8_REG_VF] != 0) {
+        fprintf(stderr, "operation_SHR_8xy6 did not shift Vx with the default profile\n");
+        return false;
+    }
+
+    // the CHIP-8 profile shifts Vy into Vx
+    chip8.quirks = CHIP8_PROFILE_CHIP8;
+    chip8.reg[1] = 0x04;
+    chip8.reg[2] = 0x03;
+    operation_apply(&chip8, &shr);
+    if (chip8.reg[1] != 0x01 || chip8.reg[CHIP8_REG_VF] != 1) {
+        fprintf(stderr, "operation_SHR_8xy6 did not shift Vy with the CHIP-8 profile\n");
+        return false;
+    }
+
+    // the CHIP-8 profile advances I past the stored registers
+    chip8.index = 0x300;
+    operation_apply(&chip8, &(struct instruction){
+        .opcode = OPCODE_LD_Fx55,
+        .x = 0x3,
+    });
+    if (chip8.index != 0x304) {
+        fprintf(stderr, "operation_LD_Fx55 did not increment I with the CHIP-8 profile\n");
+        return false;
+    }
+
+    // the SUPER-CHIP profile jumps relative to Vx
+    chip8.quirks = CHIP8_PROFILE_SCHIP;
+    chip8.reg[CHIP8_REG_V0] = 0x10;
+    chip8.reg[2] = 0x20;
+    operation_apply(&chip8, &(struct instruction){
+        .opcode = OPCODE_JP_Bnnn,
+        .nnn = 0x234,
+        .x = 0x2,
+    });
+    if (chip8.pc != 0x254) {
+        fprintf(stderr, "operation_JP_Bnnn did not jump relative to Vx with the SUPER-CHIP profile\n");
+        return false;
+    }
+
+    return true;
+}
+
+bool
+test_operation_memory_guard(void)
+{
+    struct chip8 chip8 = { 0 };
+    chip8_init(&chip8);
+
+    for (long i = 0; i < CHIP8_REG_SIZE; i++) {
+        chip8.reg[i] = 0xa0 + i;
+    }
+
+    // storing all registers at the top of memory wraps to the start
+    chip8.index = 0xffc;
+    operation_apply(&chip8, &(struct instruction){
+        .opcode = OPCODE_LD_Fx55,
+        .x = 0xf,
+    });
+    if (chip8.mem[0xfff] != 0xa3 || chip8.mem[0x000] != 0xa4 || chip8.mem[0x00b] != 0xaf) {
+        fprintf(stderr, "operation_LD_Fx55 did not wrap around the end of memory\n");
+        return false;
+    }
+    if (chip8.mem[CHIP8_MEM_SIZE + 0] != 0xa4 || chip8.mem[CHIP8_MEM_SIZE + 0xb] != 0xaf) {
+        fprintf(stderr, "operation_LD_Fx55 did not leave the guard region mirrored\n");
+        return false;
+    }
+
+    // reading back across the end of memory sees the wrapped values
+    memset(chip8.reg, 0, sizeof(chip8.reg));
+    operation_apply(&chip8, &(struct instruction){
+        .opcode = OPCODE_LD_Fx65,
+        .x = 0xf,
+    });
+    if (chip8.reg[4] != 0xa4 || chip8.reg[0xf] != 0xaf) {
+        fprintf(stderr, "operation_LD_Fx65 did not read the mirrored start of memory\n");
+        return false;
+    }
+
+    // writes to the start of memory show up in the guard region
+    chip8.index = 0x000;
+    chip8.reg[2] = 123;
+    operation_apply(&chip8, &(struct instruction){
+        .opcode = OPCODE_LD_Fx33,
+        .x = 0x2,
+    });
+    if (chip8.mem[CHIP8_MEM_SIZE + 0] != 1 || chip8.mem[CHIP8_MEM_SIZE + 2] != 3) {
+        fprintf(stderr, "operation_LD_Fx33 did not mirror into the guard region\n");
+        return false;
+    }
+
+    // I is kept within 12 bits
+    chip8.index = 0xff0;
+    chip8.reg[1] = 0x20;
+    operation_apply(&chip8, &(struct instruction){
+        .opcode = OPCODE_ADD_Fx1E,
+        .x = 0x1,
+    });
+    if (chip8.index != 0x010) {
+        fprintf(stderr, "operation_ADD_Fx1E did not mask I to 12 bits\n");
+        return false;
+    }
+
+    return true;
+}
+
+bool
+test_operation_schip(void)
+{
+    struct chip8 chip8 = { 0 };
+    chip8_init(&chip8);
+    operation_apply(&chip8, &(struct instruction){ .opcode = OPCODE_HIGH_00FF });
+
+    // a 16x16 sprite at x = 56 straddles the two words of each row
+    memset(chip8.mem + 0x300, 0xff, 32);
+    chip8.index = 0x300;
+    chip8.reg[0] = 56;
+    chip8.reg[1] = 60;
+    operation_apply(&chip8, &(struct instruction){ .opcode = OPCODE_DRW_Dxy0, .x = 0, .y = 1 });
+    if (!chip8_pixel_on(&chip8, 56, 60) || !chip8_pixel_on(&chip8, 71, 63) || chip8_pixel_on(&chip8, 72, 60)) {
+        fprintf(stderr, "operation_DRW_Dxy0 did not draw a 16x16 sprite across words\n");
+        return false;
+    }
+
+    // rows past the bottom wrap to the top with the default profile
+    if (!chip8_pixel_on(&chip8, 56, 0) || !chip8_pixel_on(&chip8, 71, 11) || chip8_pixel_on(&chip8, 56, 12)) {
+        fprintf(stderr, "operation_DRW_Dxy0 did not wrap rows past the bottom\n");
+        return false;
+    }
+
+    // scrolling right carries bits from the first word into the second
+    operation_apply(&chip8, &(struct instruction){ .opcode = OPCODE_SCR_00FB });
+    if (chip8_pixel_on(&chip8, 59, 60) || !chip8_pixel_on(&chip8, 60, 60) || !chip8_pixel_on(&chip8, 75, 60)) {
+        fprintf(stderr, "operation_SCR_00FB did not scroll right by 4 pixels\n");
+        return false;
+    }
+
+    operation_apply(&chip8, &(struct instruction){ .opcode = OPCODE_SCL_00FC });
+    if (!chip8_pixel_on(&chip8, 56, 60) || chip8_pixel_on(&chip8, 72, 60)) {
+        fprintf(stderr, "operation_SCL_00FC did not scroll left by 4 pixels\n");
+        return false;
+    }
+
+    operation_apply(&chip8, &(struct instruction){ .opcode = OPCODE_SCD_00Cn, .n = 2 });
+    if (chip8_pixel_on(&chip8, 56, 0) || !chip8_pixel_on(&chip8, 56, 2) || !chip8_pixel_on(&chip8, 56, 13)) {
+        fprintf(stderr, "operation_SCD_00Cn did not scroll down by 2 rows\n");
+        return false;
+    }
+
+    // in low resolution an 8-wide sprite at x = 60 wraps around the single word
+    operation_apply(&chip8, &(struct instruction){ .opcode = OPCODE_LOW_00FE });
+    chip8.reg[0] = 60;
+    chip8.reg[1] = 0;
+    operation_apply(&chip8, &(struct instruction){ .opcode = OPCODE_DRW_Dxyn, .x = 0, .y = 1, .n = 1 });
+    if (!chip8_pixel_on(&chip8, 63, 0) || !chip8_pixel_on(&chip8, 3, 0) || chip8_pixel_on(&chip8, 4, 0)) {
+        fprintf(stderr, "operation_DRW_Dxyn did not wrap in low resolution\n");
+        return false;
+    }
+
+    // drawing the same sprite again erases it and reports a collision
+    operation_apply(&chip8, &(struct instruction){ .opcode = OPCODE_DRW_Dxyn, .x = 0, .y = 1, .n = 1 });
+    if (chip8.reg[CHIP8_REG_VF] != 1 || chip8_pixel_on(&chip8, 63, 0)) {
+        fprintf(stderr, "operation_DRW_Dxyn did not report a collision\n");
+        return false;
+    }
+
+    // the flag registers round trip and the big font follows the small one
+    chip8.reg[0] = 7;
+    chip8.reg[1] = 9;
+    operation_apply(&chip8, &(struct instruction){ .opcode = OPCODE_LD_Fx75, .x = 1 });
+    memset(chip8.reg, 0, sizeof(chip8.reg));
+    operation_apply(&chip8, &(struct instruction){ .opcode = OPCODE_LD_Fx85, .x = 1 });
+    chip8.reg[2] = 1;
+    operation_apply(&chip8, &(struct instruction){ .opcode = OPCODE_LD_Fx30, .x = 2 });
+    if (chip8.reg[0] != 7 || chip8.reg[1] != 9 || chip8.index != CHIP8_BIG_FONT_ADDR + CHIP8_BIG_FONT_SIZE || chip8.mem[chip8.index] != 0x18) {
+        fprintf(stderr, "operation_LD_Fx75 / Fx85 / Fx30 did not behave as expected\n");
+        return false;
+    }
+
+    return true;
+}
+
+bool
+test_operation_xochip(void)
+{
+    struct chip8 chip8 = { 0 };
+    chip8_init(&chip8);
+
+    // a long I load below 4K keeps the small memory
+    const uint8_t rom[] = { 0xf0, 0x00, 0x0e, 0x00, 0xf0, 0x00, 0x20, 0x00 };
+    chip8_load(&chip8, rom, sizeof(rom));
+    chip8_step(&chip8);
+    if (chip8.index != 0x0e00 || chip8.pc != 0x204 || chip8.xmem != NULL) {
+        fprintf(stderr, "operation_LD_F000 did not load I within classic memory\n");
+        return false;
+    }
+
+    // one above it switches the machine to 64K memory
+    chip8_step(&chip8);
+    if (chip8.index != 0x2000 || chip8.pc != 0x208 || chip8.xmem == NULL || chip8.xmem[0x200] != 0xf0) {
+        fprintf(stderr, "operation_LD_F000 did not extend memory for a high address\n");
+        chip8_free(&chip8);
+        return false;
+    }
+
+    // a skip steps over the whole of a long I load
+    chip8.pc = 0x202;
+    chip8.reg[1] = 5;
+    operation_apply(&chip8, &(struct instruction){ .opcode = OPCODE_SE_3xkk, .x = 1, .kk = 5 });
+    if (chip8.pc != 0x208) {
+        fprintf(stderr, "operation_SE_3xkk did not skip a four byte instruction\n");
+        chip8_free(&chip8);
+        return false;
+    }
+
+    // registers are saved and loaded in either order, above 4K
+    chip8.reg[2] = 0x22;
+    chip8.reg[3] = 0x33;
+    operation_apply(&chip8, &(struct instruction){ .opcode = OPCODE_LD_5xy2, .x = 3, .y = 2 });
+    memset(chip8.reg, 0, sizeof(chip8.reg));
+    operation_apply(&chip8, &(struct instruction){ .opcode = OPCODE_LD_5xy3, .x = 2, .y = 3 });
+    if (chip8.xmem[0x2000] != 0x33 || chip8.xmem[0x2001] != 0x22 || chip8.reg[2] != 0x33 || chip8.reg[3] != 0x22) {
+        fprintf(stderr, "operation_LD_5xy2 / 5xy3 did not save and load a register range\n");
+        chip8_free(&chip8);
+        return false;
+    }
+
+    // with both planes selected each plane takes its own sprite
+    chip8.xmem[0x2000] = 0x80;
+    chip8.xmem[0x2001] = 0x40;
+    operation_apply(&chip8, &(struct instruction){ .opcode = OPCODE_PLANE_Fn01, .x = 3 });
+    memset(chip8.reg, 0, sizeof(chip8.reg));
+    operation_apply(&chip8, &(struct instruction){ .opcode = OPCODE_DRW_Dxyn, .x = 0, .y = 0, .n = 1 });
+    if (chip8_pixel(&chip8, 0, 0) != 1 || chip8_pixel(&chip8, 1, 0) != 2) {
+        fprintf(stderr, "operation_DRW_Dxyn did not draw to both planes\n");
+        chip8_free(&chip8);
+        return false;
+    }
+
+    // copies get their own extended memory
+    struct chip8 copy = { 0 };
+    if (chip8_copy(&copy, &chip8) != CHIP8_OK || copy.xmem == chip8.xmem || copy.xmem[0x2000] != 0x80) {
+        fprintf(stderr, "chip8_copy did not duplicate extended memory\n");
+        chip8_free(&copy);
+        chip8_free(&chip8);
+        return false;
+    }
+
+    chip8_free(&copy);
+    chip8_free(&chip8);
+    return true;
+}
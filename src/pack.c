@@ -0,0 +1,255 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "chip8.h"
+#include "pack.h"
+
+static const char PACK_MAGIC[8] = { 'S', 'K', 'Y', 'P', 'A', 'C', 'K', '1' };
+
+static uint32_t
+pack_read32(const uint8_t* p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint64_t
+pack_read64(const uint8_t* p)
+{
+    return (uint64_t)pack_read32(p) | (uint64_t)pack_read32(p + 4) << 32;
+}
+
+static void
+pack_write32(uint8_t* p, uint32_t value)
+{
+    for (long i = 0; i < 4; i++) p[i] = value >> (i * 8);
+}
+
+static void
+pack_write64(uint8_t* p, uint64_t value)
+{
+    pack_write32(p, (uint32_t)value);
+    pack_write32(p + 4, (uint32_t)(value >> 32));
+}
+
+// Map the file on POSIX systems and read it into memory elsewhere
+static int
+pack_map(struct pack* pack, const char* path)
+{
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return PACK_ERROR_OPEN;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return PACK_ERROR_FORMAT;
+    }
+
+    void* base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return PACK_ERROR_MAP;
+
+    pack->base = base;
+    pack->size = st.st_size;
+    pack->mapped = true;
+    return PACK_OK;
+#else
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL) return PACK_ERROR_OPEN;
+
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    uint8_t* base = size > 0 ? malloc(size) : NULL;
+    if (base == NULL || fread(base, 1, size, fp) != (size_t)size) {
+        free(base);
+        fclose(fp);
+        return PACK_ERROR_MAP;
+    }
+    fclose(fp);
+
+    pack->base = base;
+    pack->size = size;
+    pack->mapped = false;
+    return PACK_OK;
+#endif
+}
+
+int
+pack_open(struct pack* pack, const char* path)
+{
+    assert(pack != NULL);
+    assert(path != NULL);
+
+    memset(pack, 0, sizeof(*pack));
+
+    int rc = pack_map(pack, path);
+    if (rc != PACK_OK) return rc;
+
+    // entries are checked as they are read, so only the table is checked here
+    if (pack->size < PACK_HEADER_SIZE || memcmp(pack->base, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0) {
+        pack_close(pack);
+        return PACK_ERROR_FORMAT;
+    }
+
+    pack->count = pack_read32(pack->base + 8);
+    if (PACK_HEADER_SIZE + pack->count * PACK_ENTRY_SIZE > pack->size) {
+        pack_close(pack);
+        return PACK_ERROR_FORMAT;
+    }
+
+    return PACK_OK;
+}
+
+int
+pack_entry(const struct pack* pack, long i, struct pack_entry* entry)
+{
+    assert(pack != NULL);
+    assert(entry != NULL);
+    assert(i >= 0 && i < pack->count);
+
+    const uint8_t* p = pack->base + PACK_HEADER_SIZE + i * PACK_ENTRY_SIZE;
+    memcpy(entry->name, p, PACK_NAME_SIZE);
+    entry->hash = pack_read64(p + 40);
+    entry->size = pack_read32(p + 48);
+    long offset = pack_read32(p + 52);
+    entry->quirks = pack_read32(p + 56);
+
+    if (entry->name[PACK_NAME_SIZE - 1] != '\0') return PACK_ERROR_FORMAT;
+    if (offset > pack->size || entry->size > pack->size - offset) return PACK_ERROR_FORMAT;
+
+    entry->data = pack->base + offset;
+    return PACK_OK;
+}
+
+int
+pack_find(const struct pack* pack, const char* name, struct pack_entry* entry)
+{
+    assert(pack != NULL);
+    assert(name != NULL);
+    assert(entry != NULL);
+
+    // entries are sorted by name, so binary search the table in place
+    long lo = 0;
+    long hi = pack->count;
+    while (lo < hi) {
+        long mid = lo + (hi - lo) / 2;
+        const char* key = (const char*)(pack->base + PACK_HEADER_SIZE + mid * PACK_ENTRY_SIZE);
+        int cmp = strncmp(name, key, PACK_NAME_SIZE);
+        if (cmp == 0) return pack_entry(pack, mid, entry);
+        if (cmp < 0) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+
+    return PACK_ERROR_NOT_FOUND;
+}
+
+int
+pack_load(const struct pack_entry* entry, struct chip8* chip8)
+{
+    assert(entry != NULL);
+    assert(chip8 != NULL);
+
+    // the quirk profile was looked up when the pack was built
+    return chip8_load_profile(chip8, entry->data, entry->size, entry->quirks);
+}
+
+void
+pack_close(struct pack* pack)
+{
+    assert(pack != NULL);
+
+#ifndef _WIN32
+    if (pack->mapped) munmap((void*)pack->base, pack->size);
+#endif
+    if (!pack->mapped) free((void*)pack->base);
+
+    memset(pack, 0, sizeof(*pack));
+}
+
+static int
+pack_compare(const void* a, const void* b)
+{
+    const struct pack_entry* const* x = a;
+    const struct pack_entry* const* y = b;
+    return strncmp((*x)->name, (*y)->name, PACK_NAME_SIZE);
+}
+
+int
+pack_write(const char* path, const struct pack_entry* entries, long count)
+{
+    assert(path != NULL);
+    assert(entries != NULL || count == 0);
+
+    const struct pack_entry** sorted = malloc((count + 1) * sizeof(*sorted));
+    uint8_t* table = calloc(1, PACK_HEADER_SIZE + count * PACK_ENTRY_SIZE);
+    if (sorted == NULL || table == NULL) {
+        free(sorted);
+        free(table);
+        return PACK_ERROR_WRITE;
+    }
+
+    for (long i = 0; i < count; i++) sorted[i] = &entries[i];
+    qsort(sorted, count, sizeof(*sorted), pack_compare);
+
+    memcpy(table, PACK_MAGIC, sizeof(PACK_MAGIC));
+    pack_write32(table + 8, count);
+
+    // ROM data follows the table in the same order as the entries
+    long offset = PACK_HEADER_SIZE + count * PACK_ENTRY_SIZE;
+    for (long i = 0; i < count; i++) {
+        uint8_t* p = table + PACK_HEADER_SIZE + i * PACK_ENTRY_SIZE;
+        strncpy((char*)p, sorted[i]->name, PACK_NAME_SIZE - 1);
+        pack_write64(p + 40, sorted[i]->hash);
+        pack_write32(p + 48, sorted[i]->size);
+        pack_write32(p + 52, offset);
+        pack_write32(p + 56, sorted[i]->quirks);
+        offset += sorted[i]->size;
+    }
+
+    int rc = PACK_OK;
+    FILE* fp = fopen(path, "wb");
+    if (fp == NULL) {
+        rc = PACK_ERROR_OPEN;
+    } else {
+        size_t size = PACK_HEADER_SIZE + count * PACK_ENTRY_SIZE;
+        if (fwrite(table, 1, size, fp) != size) rc = PACK_ERROR_WRITE;
+        for (long i = 0; i < count && rc == PACK_OK; i++) {
+            if (fwrite(sorted[i]->data, 1, sorted[i]->size, fp) != (size_t)sorted[i]->size) rc = PACK_ERROR_WRITE;
+        }
+        if (fclose(fp) != 0) rc = PACK_ERROR_WRITE;
+    }
+
+    free(sorted);
+    free(table);
+    return rc;
+}
+
+const char*
+pack_error_message(int error)
+{
+    switch (error) {
+    case PACK_OK: return "OK";
+    case PACK_ERROR_OPEN: return "failed to open pack";
+    case PACK_ERROR_MAP: return "failed to map pack into memory";
+    case PACK_ERROR_FORMAT: return "malformed pack";
+    case PACK_ERROR_NOT_FOUND: return "rom not found in pack";
+    case PACK_ERROR_WRITE: return "failed to write pack";
+    default: return "unknown error";
+    }
+}
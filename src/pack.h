@@ -0,0 +1,55 @@
+#ifndef SKYLARK_PACK_H_INCLUDED
+#define SKYLARK_PACK_H_INCLUDED
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+// A pack is a single file holding many ROMs:
+//
+//   header   magic "SKYPACK1", u32 entry count, u32 reserved
+//   entries  name[40], u64 hash, u32 size, u32 offset, u32 quirks, u32 reserved
+//   data     ROM contents, each at the offset recorded in its entry
+//
+// All integers are little-endian and entries are sorted by name.
+enum {
+    PACK_HEADER_SIZE = 16,
+    PACK_ENTRY_SIZE = 64,
+    PACK_NAME_SIZE = 40,
+};
+
+enum pack_status {
+    PACK_OK = 0,
+    PACK_ERROR_OPEN,
+    PACK_ERROR_MAP,
+    PACK_ERROR_FORMAT,
+    PACK_ERROR_NOT_FOUND,
+    PACK_ERROR_WRITE,
+};
+
+struct pack_entry {
+    char name[PACK_NAME_SIZE];
+    uint64_t hash;
+    long size;
+    int quirks;
+    const uint8_t* data;
+};
+
+// The whole file is mapped read-only and entries point straight into it
+struct pack {
+    const uint8_t* base;
+    long size;
+    long count;
+    bool mapped;
+};
+
+int pack_open(struct pack* pack, const char* path);
+int pack_entry(const struct pack* pack, long i, struct pack_entry* entry);
+int pack_find(const struct pack* pack, const char* name, struct pack_entry* entry);
+int pack_load(const struct pack_entry* entry, struct chip8* chip8);
+void pack_close(struct pack* pack);
+int pack_write(const char* path, const struct pack_entry* entries, long count);
+const char* pack_error_message(int error);
+
+#endif
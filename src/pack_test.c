@@ -0,0 +1,62 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pack.c"
+
+bool
+test_pack_roundtrip(void)
+{
+    const char* path = "skylark_pack_test.pak";
+    const uint8_t first[] = { 0x12, 0x00 };
+    const uint8_t second[] = { 0x60, 0x05, 0x12, 0x02 };
+
+    // written out of order to check that the table is sorted
+    struct pack_entry entries[2] = { 0 };
+    strcpy(entries[0].name, "zeta.rom");
+    entries[0].size = sizeof(second);
+    entries[0].quirks = CHIP8_PROFILE_SCHIP;
+    entries[0].data = second;
+    strcpy(entries[1].name, "alpha.rom");
+    entries[1].size = sizeof(first);
+    entries[1].data = first;
+
+    int rc = pack_write(path, entries, 2);
+    if (rc != PACK_OK) {
+        fprintf(stderr, "pack_write failed: %s\n", pack_error_message(rc));
+        return false;
+    }
+
+    struct pack pack = { 0 };
+    rc = pack_open(&pack, path);
+    remove(path);
+    if (rc != PACK_OK) {
+        fprintf(stderr, "pack_open failed: %s\n", pack_error_message(rc));
+        return false;
+    }
+
+    bool ok = true;
+    struct pack_entry entry = { 0 };
+    if (pack_find(&pack, "missing.rom", &entry) != PACK_ERROR_NOT_FOUND) {
+        fprintf(stderr, "pack_find found a rom that was never packed\n");
+        ok = false;
+    }
+
+    rc = pack_find(&pack, "zeta.rom", &entry);
+    if (rc != PACK_OK || entry.size != sizeof(second) || memcmp(entry.data, second, sizeof(second)) != 0) {
+        fprintf(stderr, "pack_find returned the wrong contents for zeta.rom\n");
+        ok = false;
+    }
+
+    struct chip8 chip8 = { 0 };
+    chip8_init(&chip8);
+    if (ok && (pack_load(&entry, &chip8) != CHIP8_OK || chip8.quirks != CHIP8_PROFILE_SCHIP || chip8.mem[CHIP8_ROM_ADDR + 3] != 0x02)) {
+        fprintf(stderr, "pack_load did not load the rom and its profile\n");
+        ok = false;
+    }
+
+    pack_close(&pack);
+    return ok;
+}
@@ -0,0 +1,153 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "phosphor.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PHOSPHOR_X86 1
+#include <immintrin.h>
+#else
+#define PHOSPHOR_X86 0
+#endif
+
+// Fade every pixel by the decay and lift it back up to the target
+static void
+phosphor_blend_scalar(uint8_t* level, const uint8_t* target, long size, uint16_t decay)
+{
+    for (long i = 0; i < size; i++) {
+        uint8_t faded = level[i] * decay >> 8;
+        level[i] = target[i] > faded ? target[i] : faded;
+    }
+}
+
+#if PHOSPHOR_X86
+
+// The same blend 16 pixels at a time, widening to 16 bits for the multiply
+__attribute__((target("sse2")))
+static void
+phosphor_blend_sse2(uint8_t* level, const uint8_t* target, long size, uint16_t decay)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i scale = _mm_set1_epi16(decay);
+
+    long i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i l = _mm_loadu_si128((const __m128i*)(level + i));
+        __m128i lo = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(l, zero), scale), 8);
+        __m128i hi = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(l, zero), scale), 8);
+        __m128i faded = _mm_packus_epi16(lo, hi);
+        __m128i t = _mm_loadu_si128((const __m128i*)(target + i));
+        _mm_storeu_si128((__m128i*)(level + i), _mm_max_epu8(t, faded));
+    }
+    phosphor_blend_scalar(level + i, target + i, size - i, decay);
+}
+
+// And 32 at a time. Unpacking and packing both work within each 128-bit
+// lane, so the pixels come back out in the order they went in.
+__attribute__((target("avx2")))
+static void
+phosphor_blend_avx2(uint8_t* level, const uint8_t* target, long size, uint16_t decay)
+{
+    __m256i zero = _mm256_setzero_si256();
+    __m256i scale = _mm256_set1_epi16(decay);
+
+    long i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i l = _mm256_loadu_si256((const __m256i*)(level + i));
+        __m256i lo = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(l, zero), scale), 8);
+        __m256i hi = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(l, zero), scale), 8);
+        __m256i faded = _mm256_packus_epi16(lo, hi);
+        __m256i t = _mm256_loadu_si256((const __m256i*)(target + i));
+        _mm256_storeu_si256((__m256i*)(level + i), _mm256_max_epu8(t, faded));
+    }
+    phosphor_blend_scalar(level + i, target + i, size - i, decay);
+}
+
+#endif
+
+void
+phosphor_init(struct phosphor* phosphor, const uint8_t levels[1 << CHIP8_PLANES], int persistence)
+{
+    assert(phosphor != NULL);
+    assert(levels != NULL);
+    assert(persistence >= 0 && persistence < 100);
+
+    memset(phosphor, 0, sizeof(*phosphor));
+    phosphor->decay = persistence * 256 / 100;
+
+    for (int i = 0; i < 1 << CHIP8_PLANES; i++) {
+        phosphor->levels[i] = levels[i] * 0x0101010101010101ULL;
+    }
+
+    // byte order in memory matches pixel order whatever the host endianness
+    for (int b = 0; b < 256; b++) {
+        uint8_t bytes[16];
+        for (int i = 0; i < 8; i++) bytes[i] = (b >> (7 - i)) & 1 ? 0xff : 0x00;
+        memcpy(&phosphor->spread[b], bytes, 8);
+        for (int i = 0; i < 16; i++) bytes[i] = (b >> (7 - i / 2)) & 1 ? 0xff : 0x00;
+        memcpy(phosphor->spread_wide[b], bytes, 16);
+    }
+
+    phosphor->blend = phosphor_blend_scalar;
+    phosphor->kernel = "scalar";
+#if PHOSPHOR_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        phosphor->blend = phosphor_blend_avx2;
+        phosphor->kernel = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        phosphor->blend = phosphor_blend_sse2;
+        phosphor->kernel = "sse2";
+    }
+#endif
+}
+
+// Pick each pixel's intensity from the masks of the two planes
+static uint64_t
+phosphor_level(const struct phosphor* phosphor, uint64_t p0, uint64_t p1)
+{
+    const uint64_t* l = phosphor->levels;
+    return (~p0 & ~p1 & l[0]) | (p0 & ~p1 & l[1]) | (~p0 & p1 & l[2]) | (p0 & p1 & l[3]);
+}
+
+void
+phosphor_frame(struct phosphor* phosphor, const struct chip8* chip8)
+{
+    assert(phosphor != NULL);
+    assert(chip8 != NULL);
+
+    // expand the packed display into one target intensity per pixel
+    bool hires = chip8_display_width(chip8) == CHIP8_DISPLAY_WIDTH;
+    for (long y = 0; y < PHOSPHOR_HEIGHT; y++) {
+        uint8_t* row = phosphor->target + y * PHOSPHOR_WIDTH;
+        long src = hires ? y : y / 2;
+        long words = hires ? CHIP8_DISPLAY_WORDS : 1;
+        for (long w = 0; w < words; w++) {
+            uint64_t word0 = chip8->display[0][src][w];
+            uint64_t word1 = chip8->display[1][src][w];
+            for (long b = 0; b < 8; b++) {
+                uint8_t byte0 = word0 >> (56 - 8 * b);
+                uint8_t byte1 = word1 >> (56 - 8 * b);
+                if (hires) {
+                    uint64_t level = phosphor_level(phosphor, phosphor->spread[byte0], phosphor->spread[byte1]);
+                    memcpy(row + w * 64 + b * 8, &level, 8);
+                } else {
+                    for (long half = 0; half < 2; half++) {
+                        uint64_t level = phosphor_level(phosphor,
+                            phosphor->spread_wide[byte0][half], phosphor->spread_wide[byte1][half]);
+                        memcpy(row + b * 16 + half * 8, &level, 8);
+                    }
+                }
+            }
+        }
+    }
+
+    phosphor->blend(phosphor->level, phosphor->target, PHOSPHOR_SIZE, phosphor->decay);
+
+    for (long i = 0; i < PHOSPHOR_SIZE; i++) {
+        phosphor->argb[i] = 0xff000000 | phosphor->level[i] * 0x010101u;
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef SKYLARK_PHOSPHOR_H_INCLUDED
+#define SKYLARK_PHOSPHOR_H_INCLUDED
+
+#include <stdint.h>
+
+#include "chip8.h"
+
+enum {
+    PHOSPHOR_WIDTH = CHIP8_DISPLAY_WIDTH,
+    PHOSPHOR_HEIGHT = CHIP8_DISPLAY_HEIGHT,
+    PHOSPHOR_SIZE = PHOSPHOR_WIDTH * PHOSPHOR_HEIGHT,
+};
+
+typedef void (*phosphor_blend_func)(uint8_t* level, const uint8_t* target, long size, uint16_t decay);
+
+// Emulates the persistence of a CRT so that sprites erased and redrawn
+// with XOR do not flicker. Every pixel keeps an intensity that decays by
+// a fixed fraction each frame and is lifted back up to whatever the
+// display shows now. The display is always expanded to full resolution,
+// with low resolution pixels doubled, and the result is ready to upload
+// as an ARGB8888 texture. Blending uses AVX2 or SSE2 where available.
+struct phosphor {
+    uint8_t target[PHOSPHOR_SIZE];
+    uint8_t level[PHOSPHOR_SIZE];
+    uint32_t argb[PHOSPHOR_SIZE];
+
+    // each byte of the display spread into a byte of ones per pixel,
+    // leftmost first, and the same again with every pixel doubled
+    uint64_t spread[256];
+    uint64_t spread_wide[256][2];
+
+    uint64_t levels[1 << CHIP8_PLANES];  // each plane combination's intensity, in every byte
+    uint16_t decay;                      // intensity kept per frame, out of 256
+    phosphor_blend_func blend;
+    const char* kernel;
+};
+
+void phosphor_init(struct phosphor* phosphor, const uint8_t levels[1 << CHIP8_PLANES], int persistence);
+void phosphor_frame(struct phosphor* phosphor, const struct chip8* chip8);
+
+#endif
@@ -0,0 +1,75 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "phosphor.c"
+
+bool
+test_phosphor_decay(void)
+{
+    const uint8_t levels[] = { 0, 255, 85, 170 };
+
+    static struct phosphor phosphor;
+    phosphor_init(&phosphor, levels, 50);
+
+    struct chip8 chip8 = { 0 };
+    chip8_init(&chip8);
+
+    // a low resolution pixel covers two by two pixels at full resolution
+    chip8.display[0][0][0] = 1ULL << 63;
+    phosphor_frame(&phosphor, &chip8);
+    const uint8_t* level = phosphor.level;
+    if (level[0] != 255 || level[1] != 255 || level[PHOSPHOR_WIDTH] != 255 || level[2] != 0) {
+        fprintf(stderr, "pixel was not doubled\n");
+        return false;
+    }
+    if (phosphor.argb[0] != 0xffffffff || phosphor.argb[2] != 0xff000000) {
+        fprintf(stderr, "pixel was not converted to ARGB\n");
+        return false;
+    }
+
+    // once erased it fades by half each frame rather than going dark
+    chip8.display[0][0][0] = 0;
+    phosphor_frame(&phosphor, &chip8);
+    if (level[0] != 127) {
+        fprintf(stderr, "pixel faded to %d after one frame\n", level[0]);
+        return false;
+    }
+    phosphor_frame(&phosphor, &chip8);
+    if (level[0] != 63) {
+        fprintf(stderr, "pixel faded to %d after two frames\n", level[0]);
+        return false;
+    }
+
+    // the selected kernel must match the scalar one, ragged tail included
+    uint8_t target[1001];
+    uint8_t expect[1001];
+    uint8_t actual[1001];
+    uint32_t rng = 1;
+    for (long i = 0; i < 1001; i++) {
+        rng = rng * 1103515245 + 12345;
+        target[i] = rng >> 24;
+        expect[i] = actual[i] = rng >> 16;
+    }
+    phosphor_blend_scalar(expect, target, 1001, 200);
+    phosphor.blend(actual, target, 1001, 200);
+    if (memcmp(expect, actual, sizeof(expect)) != 0) {
+        fprintf(stderr, "%s kernel disagrees with scalar\n", phosphor.kernel);
+        return false;
+    }
+#if PHOSPHOR_X86
+    // SSE2 is only picked without AVX2, so check it directly as well
+    memcpy(actual, expect, sizeof(actual));
+    phosphor_blend_scalar(expect, target, 1001, 200);
+    phosphor_blend_sse2(actual, target, 1001, 200);
+    if (memcmp(expect, actual, sizeof(expect)) != 0) {
+        fprintf(stderr, "sse2 kernel disagrees with scalar\n");
+        return false;
+    }
+#endif
+
+    return true;
+}
@@ -0,0 +1,92 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "pool.h"
+
+int
+pool_init(struct pool* pool, long count)
+{
+    assert(pool != NULL);
+    assert(count > 0);
+
+    memset(pool, 0, sizeof(*pool));
+
+    // round each slot up so that every machine starts on a cache line
+    long stride = sizeof(struct chip8);
+    stride = (stride + CHIP8_CACHE_LINE - 1) / CHIP8_CACHE_LINE * CHIP8_CACHE_LINE;
+
+    // the first slot holds the reset image
+    pool->block = calloc(1, (count + 1) * stride + CHIP8_CACHE_LINE);
+    if (pool->block == NULL) return POOL_ERROR_ALLOC;
+
+    uintptr_t addr = (uintptr_t)pool->block;
+    addr = (addr + CHIP8_CACHE_LINE - 1) / CHIP8_CACHE_LINE * CHIP8_CACHE_LINE;
+
+    pool->base = (unsigned char*)addr + stride;
+    pool->stride = stride;
+    pool->count = count;
+    pool->image = (struct chip8*)addr;
+
+    chip8_init(pool->image);
+    return pool_reset_all(pool);
+}
+
+int
+pool_load(struct pool* pool, const uint8_t* rom, long size)
+{
+    assert(pool != NULL);
+    assert(rom != NULL);
+
+    // the image is built once here so resets never re-run init and load
+    chip8_free(pool->image);
+    chip8_init(pool->image);
+    if (chip8_load(pool->image, rom, size) != CHIP8_OK) return POOL_ERROR_LOAD;
+
+    return pool_reset_all(pool);
+}
+
+struct chip8*
+pool_get(struct pool* pool, long i)
+{
+    assert(pool != NULL);
+    assert(i >= 0 && i < pool->count);
+
+    return (struct chip8*)(pool->base + (i * pool->stride));
+}
+
+int
+pool_reset(struct pool* pool, long i)
+{
+    // machines keep their extended memory across resets of an XO-CHIP image
+    if (chip8_copy(pool_get(pool, i), pool->image) != CHIP8_OK) return POOL_ERROR_ALLOC;
+    return POOL_OK;
+}
+
+int
+pool_reset_all(struct pool* pool)
+{
+    assert(pool != NULL);
+
+    for (long i = 0; i < pool->count; i++) {
+        int rc = pool_reset(pool, i);
+        if (rc != POOL_OK) return rc;
+    }
+
+    return POOL_OK;
+}
+
+void
+pool_free(struct pool* pool)
+{
+    assert(pool != NULL);
+
+    if (pool->block != NULL) {
+        for (long i = 0; i < pool->count; i++) chip8_free(pool_get(pool, i));
+        chip8_free(pool->image);
+    }
+    free(pool->block);
+    memset(pool, 0, sizeof(*pool));
+}
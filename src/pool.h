@@ -0,0 +1,32 @@
+#ifndef SKYLARK_POOL_H_INCLUDED
+#define SKYLARK_POOL_H_INCLUDED
+
+#include <stdint.h>
+
+#include "chip8.h"
+
+enum pool_status {
+    POOL_OK = 0,
+    POOL_ERROR_ALLOC,
+    POOL_ERROR_LOAD,
+};
+
+// A pool holds many machines in one cache-line aligned allocation along
+// with a reset image: a machine that has already had its font and ROM
+// loaded. Resetting a machine is a single copy from that image.
+struct pool {
+    void* block;
+    unsigned char* base;
+    long stride;
+    long count;
+    struct chip8* image;
+};
+
+int pool_init(struct pool* pool, long count);
+int pool_load(struct pool* pool, const uint8_t* rom, long size);
+struct chip8* pool_get(struct pool* pool, long i);
+int pool_reset(struct pool* pool, long i);
+int pool_reset_all(struct pool* pool);
+void pool_free(struct pool* pool);
+
+#endif
@@ -0,0 +1,50 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pool.c"
+
+bool
+test_pool_reset(void)
+{
+    // LD V1, 0x42 followed by a jump back to the start
+    const uint8_t rom[] = { 0x61, 0x42, 0x12, 0x00 };
+
+    struct pool pool = { 0 };
+    if (pool_init(&pool, 3) != POOL_OK) {
+        fprintf(stderr, "pool_init failed to allocate\n");
+        return false;
+    }
+    if (pool_load(&pool, rom, sizeof(rom)) != POOL_OK) {
+        fprintf(stderr, "pool_load failed to load the rom\n");
+        pool_free(&pool);
+        return false;
+    }
+
+    bool ok = true;
+    for (long i = 0; i < pool.count; i++) {
+        struct chip8* chip8 = pool_get(&pool, i);
+        if ((uintptr_t)chip8 % CHIP8_CACHE_LINE != 0) {
+            fprintf(stderr, "pool_get returned a machine that is not cache line aligned\n");
+            ok = false;
+        }
+    }
+
+    struct chip8* chip8 = pool_get(&pool, 1);
+    chip8_step(chip8);
+    if (chip8->reg[1] != 0x42 || chip8->pc != CHIP8_ROM_ADDR + 2) {
+        fprintf(stderr, "pooled machine did not execute its rom\n");
+        ok = false;
+    }
+
+    pool_reset(&pool, 1);
+    if (memcmp(chip8, pool.image, sizeof(*chip8)) != 0) {
+        fprintf(stderr, "pool_reset did not restore the reset image\n");
+        ok = false;
+    }
+
+    pool_free(&pool);
+    return ok;
+}
@@ -0,0 +1,70 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "quirk.h"
+
+// ROMs known to need something other than the default quirk profile,
+// keyed by the FNV-1a hash of the ROM image (see hash_bytes). entries come
+// from running each ROM in roms/ headless with every quirk toggled on its own
+// and keeping the quirks whose display differs and is the one that draws
+// correctly; the other ROMs draw correctly with the default profile
+static const struct {
+    uint64_t hash;
+    int quirks;
+} QUIRK_ROMS[] = {
+    { UINT64_C(0x29bcab9b664d212b), CHIP8_PROFILE_DEFAULT | CHIP8_QUIRK_DRAW_CLIP },  /* blitz.rom */
+    { UINT64_C(0x3e2c2d43b296b74c), CHIP8_PROFILE_DEFAULT | CHIP8_QUIRK_DRAW_CLIP },  /* tank.rom */
+    { UINT64_C(0x8d8a02fa3a2ed293), CHIP8_PROFILE_DEFAULT | CHIP8_QUIRK_DRAW_CLIP },  /* ufo.rom */
+};
+
+static const struct {
+    const char* name;
+    int quirks;
+} QUIRK_PROFILES[] = {
+    { "default", CHIP8_PROFILE_DEFAULT },
+    { "chip8", CHIP8_PROFILE_CHIP8 },
+    { "schip", CHIP8_PROFILE_SCHIP },
+};
+
+int
+quirk_lookup(uint64_t hash)
+{
+    long num_roms = sizeof(QUIRK_ROMS) / sizeof(*QUIRK_ROMS);
+    for (long i = 0; i < num_roms; i++) {
+        if (QUIRK_ROMS[i].hash == hash) return QUIRK_ROMS[i].quirks;
+    }
+
+    return CHIP8_PROFILE_DEFAULT;
+}
+
+int
+quirk_profile(const char* name)
+{
+    assert(name != NULL);
+
+    long num_profiles = sizeof(QUIRK_PROFILES) / sizeof(*QUIRK_PROFILES);
+    for (long i = 0; i < num_profiles; i++) {
+        if (strcmp(QUIRK_PROFILES[i].name, name) == 0) return QUIRK_PROFILES[i].quirks;
+    }
+
+    // fall back to a raw quirk bitmask such as "0x11"
+    char* end = NULL;
+    long quirks = strtol(name, &end, 0);
+    if (*name == '\0' || *end != '\0' || quirks < 0 || quirks > CHIP8_QUIRK_MASK) return -1;
+
+    return quirks;
+}
+
+const char*
+quirk_name(int quirks)
+{
+    long num_profiles = sizeof(QUIRK_PROFILES) / sizeof(*QUIRK_PROFILES);
+    for (long i = 0; i < num_profiles; i++) {
+        if (QUIRK_PROFILES[i].quirks == quirks) return QUIRK_PROFILES[i].name;
+    }
+
+    return NULL;
+}
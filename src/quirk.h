@@ -0,0 +1,10 @@
+#ifndef SKYLARK_QUIRK_H_INCLUDED
+#define SKYLARK_QUIRK_H_INCLUDED
+
+#include <stdint.h>
+
+int quirk_lookup(uint64_t hash);
+int quirk_profile(const char* name);
+const char* quirk_name(int quirks);
+
+#endif
@@ -0,0 +1,136 @@
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "cache.h"
+#include "chip8.h"
+#include "rollback.h"
+
+// Run one frame from the present state, snapshotting it first and filling
+// in a prediction for every player whose keys have not arrived
+static int
+rollback_run(struct rollback* rollback, long frame)
+{
+    struct rollback_frame* slot = &rollback->frames[frame % ROLLBACK_WINDOW];
+
+    uint16_t input = 0;
+    for (int player = 0; player < ROLLBACK_PLAYERS; player++) {
+        if (!(slot->confirmed & 1 << player)) slot->input[player] = rollback->last[player];
+        input |= slot->input[player];
+    }
+
+    int rc = chip8_copy(&slot->state, &rollback->chip8);
+    if (rc != CHIP8_OK) return rc;
+
+    struct chip8_event event = { 0 };
+    chip8_set_input(&rollback->chip8, input);
+    rc = chip8_run_until(&rollback->chip8, CHIP8_EVENT_FRAME, chip8_frame_steps(&rollback->chip8), &event);
+    rollback->stats.steps += event.steps;
+    return rc;
+}
+
+int
+rollback_init(struct rollback* rollback, const struct chip8* start)
+{
+    assert(rollback != NULL);
+    assert(start != NULL);
+
+    memset(rollback, 0, sizeof(*rollback));
+    rollback->pending = -1;
+    for (int player = 0; player < ROLLBACK_PLAYERS; player++) rollback->last_frame[player] = -1;
+
+    if (chip8_copy(&rollback->chip8, start) != CHIP8_OK) return ROLLBACK_ERROR_ALLOC;
+
+    // snapshots never run, so only the machine itself needs a cache view
+    cache_init(&rollback->cache);
+    if (start->cache != NULL && rollback->chip8.xmem == NULL) {
+        cache_attach(&rollback->cache, rollback->chip8.mem);
+        rollback->chip8.cache = &rollback->cache;
+    }
+
+    return ROLLBACK_OK;
+}
+
+int
+rollback_input(struct rollback* rollback, int player, long frame, uint16_t mask)
+{
+    assert(rollback != NULL);
+    assert(player >= 0 && player < ROLLBACK_PLAYERS);
+
+    if (frame > rollback->frame) return ROLLBACK_ERROR_TOO_EARLY;
+    if (frame <= rollback->frame - ROLLBACK_WINDOW) return ROLLBACK_ERROR_TOO_LATE;
+
+    // keys for a frame that already ran only matter if they were guessed wrong
+    struct rollback_frame* slot = &rollback->frames[frame % ROLLBACK_WINDOW];
+    if (frame < rollback->frame && slot->input[player] != mask) {
+        if (rollback->pending < 0 || frame < rollback->pending) rollback->pending = frame;
+    }
+    slot->input[player] = mask;
+    slot->confirmed |= 1 << player;
+
+    if (frame > rollback->last_frame[player]) {
+        rollback->last[player] = mask;
+        rollback->last_frame[player] = frame;
+    }
+
+    return ROLLBACK_OK;
+}
+
+int
+rollback_advance(struct rollback* rollback)
+{
+    assert(rollback != NULL);
+
+    // go back to the earliest mispredicted frame and catch up to the present
+    if (rollback->pending >= 0) {
+        long from = rollback->pending;
+        rollback->pending = -1;
+
+        int rc = chip8_copy(&rollback->chip8, &rollback->frames[from % ROLLBACK_WINDOW].state);
+        if (rc != CHIP8_OK) return rc;
+        for (long frame = from; frame < rollback->frame; frame++) {
+            rc = rollback_run(rollback, frame);
+            if (rc != CHIP8_OK) return rc;
+        }
+
+        long depth = rollback->frame - from;
+        rollback->stats.rollbacks += 1;
+        rollback->stats.resimulated += depth;
+        if (depth > rollback->stats.max_depth) rollback->stats.max_depth = depth;
+    }
+
+    struct rollback_frame* slot = &rollback->frames[rollback->frame % ROLLBACK_WINDOW];
+    if (slot->confirmed != (1 << ROLLBACK_PLAYERS) - 1) rollback->stats.predicted += 1;
+
+    int rc = rollback_run(rollback, rollback->frame);
+    if (rc != CHIP8_OK) return rc;
+    rollback->frame += 1;
+    rollback->stats.frames += 1;
+
+    // the oldest frame leaves the window to make room for the next one
+    rollback->frames[rollback->frame % ROLLBACK_WINDOW].confirmed = 0;
+
+    return CHIP8_OK;
+}
+
+void
+rollback_free(struct rollback* rollback)
+{
+    assert(rollback != NULL);
+
+    chip8_free(&rollback->chip8);
+    cache_release(&rollback->cache);
+    for (long i = 0; i < ROLLBACK_WINDOW; i++) chip8_free(&rollback->frames[i].state);
+}
+
+const char*
+rollback_error_message(int error)
+{
+    switch (error) {
+    case ROLLBACK_OK: return "OK";
+    case ROLLBACK_ERROR_ALLOC: return "failed to allocate memory";
+    case ROLLBACK_ERROR_TOO_LATE: return "input is older than the rollback window";
+    case ROLLBACK_ERROR_TOO_EARLY: return "input is for a frame that is not next";
+    default: return "unknown error";
+    }
+}
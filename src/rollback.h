@@ -0,0 +1,62 @@
+#ifndef SKYLARK_ROLLBACK_H_INCLUDED
+#define SKYLARK_ROLLBACK_H_INCLUDED
+
+#include <stdint.h>
+
+#include "cache.h"
+#include "chip8.h"
+
+enum {
+    ROLLBACK_PLAYERS = 2,
+    ROLLBACK_WINDOW = 16,  // frames that late input can still reach back to
+};
+
+enum rollback_status {
+    ROLLBACK_OK = 0,
+    ROLLBACK_ERROR_ALLOC,
+    ROLLBACK_ERROR_TOO_LATE,
+    ROLLBACK_ERROR_TOO_EARLY,
+};
+
+// One frame of history: the state the frame started from and the keys
+// each player held during it, whether confirmed or predicted.
+struct rollback_frame {
+    struct chip8 state;
+    uint16_t input[ROLLBACK_PLAYERS];
+    uint8_t confirmed;
+};
+
+struct rollback_stats {
+    long frames;
+    long predicted;
+    long rollbacks;
+    long resimulated;
+    long max_depth;
+    long steps;  // instructions run, resimulation included
+};
+
+// Runs one machine for two players whose keys arrive at different times.
+// Each player holds its own set of keys and the machine sees them all at
+// once. A player whose keys for a frame have not arrived yet is predicted
+// to hold whatever it last held. When keys arrive that differ from the
+// prediction, the next advance restores the snapshot taken before that
+// frame and runs forward again to the present with the corrected keys.
+// The machine gets its own decode cache view if the start machine had one.
+struct rollback {
+    struct chip8 chip8;
+    struct cache cache;
+    struct rollback_frame frames[ROLLBACK_WINDOW];
+    long frame;    // the next frame to run
+    long pending;  // the earliest frame to run again, or -1
+    uint16_t last[ROLLBACK_PLAYERS];
+    long last_frame[ROLLBACK_PLAYERS];
+    struct rollback_stats stats;
+};
+
+int rollback_init(struct rollback* rollback, const struct chip8* start);
+int rollback_input(struct rollback* rollback, int player, long frame, uint16_t mask);
+int rollback_advance(struct rollback* rollback);
+void rollback_free(struct rollback* rollback);
+const char* rollback_error_message(int error);
+
+#endif
@@ -0,0 +1,109 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "rollback.c"
+
+bool
+test_rollback_resimulate(void)
+{
+    // count the steps each player spends holding their key
+    const uint8_t rom[] = {
+        0x62, 0x0c,  // 200: LD V2, 0C
+        0xe0, 0xa1,  // 202: SKNP V0
+        0x71, 0x01,  // 204: ADD V1, 01
+        0xe2, 0xa1,  // 206: SKNP V2
+        0x73, 0x01,  // 208: ADD V3, 01
+        0x12, 0x02,  // 20A: JP 202
+    };
+
+    const long delay = 3;
+    const long frames = 60;
+
+    struct cache cache;
+    cache_init(&cache);
+    struct chip8 plain = { 0 };
+    chip8_init(&plain);
+    plain.cache = &cache;
+    chip8_load(&plain, rom, sizeof(rom));
+
+    static struct rollback rollback;
+    if (rollback_init(&rollback, &plain) != ROLLBACK_OK) {
+        fprintf(stderr, "failed to init rollback\n");
+        chip8_free(&plain);
+        cache_release(&cache);
+        return false;
+    }
+
+    // the local player holds key 0 every other frame, and the remote
+    // player's key C arrives late and changes every seven frames
+    uint16_t local[frames + 1];
+    uint16_t remote[frames + 1];
+    for (long frame = 0; frame <= frames; frame++) {
+        local[frame] = frame % 2 == 0 ? 1 << 0x0 : 0;
+        remote[frame] = frame / 7 % 2 == 0 ? 1 << 0xc : 0;
+    }
+
+    bool ok = true;
+    for (long frame = 0; frame < frames && ok; frame++) {
+        chip8_set_input(&plain, local[frame] | remote[frame]);
+        chip8_frame(&plain);
+
+        int rc = rollback_input(&rollback, 0, frame, local[frame]);
+        if (rc == ROLLBACK_OK && frame >= delay) rc = rollback_input(&rollback, 1, frame - delay, remote[frame - delay]);
+        if (rc != ROLLBACK_OK || rollback_advance(&rollback) != CHIP8_OK) {
+            fprintf(stderr, "failed to advance frame %ld\n", frame);
+            ok = false;
+        }
+    }
+
+    // once every late input is in, the next frame must match exactly
+    for (long frame = frames - delay; frame <= frames && ok; frame++) {
+        if (rollback_input(&rollback, 1, frame, remote[frame]) != ROLLBACK_OK) ok = false;
+    }
+    if (ok && rollback_input(&rollback, 0, frames, local[frames]) != ROLLBACK_OK) ok = false;
+    if (ok) {
+        chip8_set_input(&plain, local[frames] | remote[frames]);
+        chip8_frame(&plain);
+        if (rollback_advance(&rollback) != CHIP8_OK || chip8_hash(&plain) != chip8_hash(&rollback.chip8)) {
+            fprintf(stderr, "rollback diverged from plain frames\n");
+            ok = false;
+        }
+    }
+
+    if (ok && rollback_input(&rollback, 1, 0, 0) != ROLLBACK_ERROR_TOO_LATE) {
+        fprintf(stderr, "rollback accepted input older than its window\n");
+        ok = false;
+    }
+    if (ok && (rollback.stats.rollbacks == 0 || rollback.stats.max_depth != delay)) {
+        fprintf(stderr, "rollback ran %ld rollbacks, %ld deep at most\n",
+            rollback.stats.rollbacks, rollback.stats.max_depth);
+        ok = false;
+    }
+
+    // the machine runs with its own cache view, and snapshots with none
+    if (ok && rollback.chip8.cache != &rollback.cache) {
+        fprintf(stderr, "rollback machine does not have its own cache view\n");
+        ok = false;
+    }
+    for (long i = 0; i < ROLLBACK_WINDOW && ok; i++) {
+        if (rollback.frames[i].state.cache != NULL) {
+            fprintf(stderr, "rollback snapshot %ld shares a cache view\n", i);
+            ok = false;
+        }
+    }
+
+    // the ROM never waits, so every frame run or rerun is a full one
+    long runs = rollback.stats.frames + rollback.stats.resimulated;
+    if (ok && rollback.stats.steps != runs * CHIP8_STEPS_PER_FRAME) {
+        fprintf(stderr, "rollback counted %ld steps over %ld frames\n", rollback.stats.steps, runs);
+        ok = false;
+    }
+
+    rollback_free(&rollback);
+    chip8_free(&plain);
+    cache_release(&cache);
+    return ok;
+}
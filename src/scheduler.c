@@ -0,0 +1,295 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "chip8.h"
+#include "scheduler.h"
+
+enum {
+    SCHEDULER_NS_PER_SEC = 1000000000,
+    SCHEDULER_FRAME_RATE = 60,
+};
+
+// Due times come from the monotonic clock so that a step in wall-clock time
+// neither stalls every task nor fires them all at once. macOS cannot time
+// condition waits against it, and falls back to the wall clock.
+#ifdef __APPLE__
+#define SCHEDULER_CLOCK CLOCK_REALTIME
+#else
+#define SCHEDULER_CLOCK CLOCK_MONOTONIC
+#endif
+
+static bool
+scheduler_before(const struct timespec* a, const struct timespec* b)
+{
+    if (a->tv_sec != b->tv_sec) return a->tv_sec < b->tv_sec;
+    return a->tv_nsec < b->tv_nsec;
+}
+
+static long long
+scheduler_elapsed(const struct timespec* from, const struct timespec* to)
+{
+    return (long long)(to->tv_sec - from->tv_sec) * SCHEDULER_NS_PER_SEC + (to->tv_nsec - from->tv_nsec);
+}
+
+static void
+scheduler_advance(struct timespec* ts, long ns)
+{
+    ts->tv_nsec += ns;
+    while (ts->tv_nsec >= SCHEDULER_NS_PER_SEC) {
+        ts->tv_nsec -= SCHEDULER_NS_PER_SEC;
+        ts->tv_sec += 1;
+    }
+}
+
+// Insert a task into the ready queue, which is kept sorted by due time.
+// The lock must be held.
+static void
+scheduler_enqueue(struct scheduler* sched, struct scheduler_task* task)
+{
+    task->state = SCHEDULER_STATE_READY;
+
+    struct scheduler_task** link = &sched->head;
+    while (*link != NULL && !scheduler_before(&task->due, &(*link)->due)) {
+        link = &(*link)->next;
+    }
+    task->next = *link;
+    *link = task;
+
+    pthread_cond_signal(&sched->ready);
+}
+
+// Take a task back out of the ready queue. The lock must be held.
+static void
+scheduler_dequeue(struct scheduler* sched, struct scheduler_task* task)
+{
+    struct scheduler_task** link = &sched->head;
+    while (*link != NULL && *link != task) link = &(*link)->next;
+    if (*link != NULL) *link = task->next;
+    task->next = NULL;
+}
+
+// Tick the timers of a task coming out of a park for every frame it
+// spent parked, as they would have ticked had it kept running. The lock
+// must be held, and the task must not be running.
+static void
+scheduler_unpark(struct scheduler* sched, struct scheduler_task* task, const struct timespec* now)
+{
+    struct chip8* chip8 = task->chip8;
+    task->sleeping = false;
+
+    long long frames = scheduler_elapsed(&task->parked, now) / sched->frame_ns;
+    long long ticks = frames * (chip8_timing(chip8) == CHIP8_TIMING_STEPS ? CHIP8_STEPS_PER_FRAME : 1);
+    chip8->timer_delay = chip8->timer_delay > ticks ? chip8->timer_delay - ticks : 0;
+    chip8->timer_sound = chip8->timer_sound > ticks ? chip8->timer_sound - ticks : 0;
+}
+
+static bool
+scheduler_key_wait(struct chip8* chip8)
+{
+    // extended machines address all 64K, and the guard region covers pc + 1
+    const uint8_t* mem = chip8_memory(chip8);
+    uint16_t pc = chip8->pc & chip8_addr_mask(chip8);
+    return (mem[pc] & 0xf0) == 0xf0 && mem[pc + 1] == 0x0a;
+}
+
+// Run the rest of a task's frame, however many steps its timing gives it,
+// stopping early if the machine can make no progress without input.
+static int
+scheduler_run(struct scheduler_task* task)
+{
+    struct chip8* chip8 = task->chip8;
+
+    long steps = chip8_frame_steps(chip8);
+    for (long i = 0; i < steps; i++) {
+        uint16_t pc = chip8->pc;
+        if (chip8_step(chip8) != CHIP8_OK) return SCHEDULER_YIELD_FAULT;
+
+        // a step that leaves pc alone is either Fx0A waiting on a key or a
+        // jump to itself, and neither can change until the input does
+        if (chip8->pc == pc) {
+            return scheduler_key_wait(chip8) ? SCHEDULER_YIELD_KEY_WAIT : SCHEDULER_YIELD_IDLE;
+        }
+        if (chip8->phase == 0) break;
+    }
+
+    return SCHEDULER_YIELD_FRAME;
+}
+
+static void*
+scheduler_worker(void* arg)
+{
+    struct scheduler* sched = arg;
+
+    pthread_mutex_lock(&sched->lock);
+    for (;;) {
+        if (sched->stopping) break;
+
+        if (sched->head == NULL) {
+            pthread_cond_wait(&sched->ready, &sched->lock);
+            continue;
+        }
+
+        struct timespec now = { 0 };
+        clock_gettime(SCHEDULER_CLOCK, &now);
+        if (scheduler_before(&now, &sched->head->due)) {
+            pthread_cond_timedwait(&sched->ready, &sched->lock, &sched->head->due);
+            continue;
+        }
+
+        struct scheduler_task* task = sched->head;
+        sched->head = task->next;
+        task->next = NULL;
+        task->state = SCHEDULER_STATE_RUNNING;
+        task->woken = false;
+        if (task->sleeping) scheduler_unpark(sched, task, &now);
+        chip8_set_input(task->chip8, task->input);
+        pthread_mutex_unlock(&sched->lock);
+
+        int yield = scheduler_run(task);
+        if (task->on_frame != NULL) task->on_frame(task);
+
+        pthread_mutex_lock(&sched->lock);
+        task->yield = yield;
+        if (yield == SCHEDULER_YIELD_FAULT) {
+            task->state = SCHEDULER_STATE_HALTED;
+        } else if (yield == SCHEDULER_YIELD_FRAME || task->woken) {
+            // a task that fell behind gives up the missed frames instead
+            // of monopolizing a worker while it catches up
+            scheduler_advance(&task->due, sched->frame_ns);
+            if (scheduler_before(&task->due, &now)) task->due = now;
+            scheduler_enqueue(sched, task);
+        } else if (task->chip8->timer_sound > 0) {
+            // a parked task would keep sounding, so it sleeps only until
+            // its sound timer runs out and then parks again
+            long ticks = chip8_timing(task->chip8) == CHIP8_TIMING_STEPS ? CHIP8_STEPS_PER_FRAME : 1;
+            long frames = (task->chip8->timer_sound + ticks - 1) / ticks;
+            task->parked = now;
+            task->sleeping = true;
+            task->due = now;
+            scheduler_advance(&task->due, frames * sched->frame_ns);
+            scheduler_enqueue(sched, task);
+        } else {
+            task->parked = now;
+            task->sleeping = true;
+            task->state = SCHEDULER_STATE_PARKED;
+        }
+    }
+    pthread_mutex_unlock(&sched->lock);
+
+    return NULL;
+}
+
+int
+scheduler_init(struct scheduler* sched, long num_workers)
+{
+    assert(sched != NULL);
+    assert(num_workers > 0);
+
+    memset(sched, 0, sizeof(*sched));
+    sched->frame_ns = SCHEDULER_NS_PER_SEC / SCHEDULER_FRAME_RATE;
+
+    sched->workers = calloc(num_workers, sizeof(*sched->workers));
+    if (sched->workers == NULL) return SCHEDULER_ERROR_ALLOC;
+
+    pthread_mutex_init(&sched->lock, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+#ifndef __APPLE__
+    pthread_condattr_setclock(&attr, SCHEDULER_CLOCK);
+#endif
+    pthread_cond_init(&sched->ready, &attr);
+    pthread_condattr_destroy(&attr);
+
+    for (long i = 0; i < num_workers; i++) {
+        if (pthread_create(&sched->workers[i], NULL, scheduler_worker, sched) != 0) {
+            scheduler_stop(sched);
+            return SCHEDULER_ERROR_THREAD;
+        }
+        sched->num_workers += 1;
+    }
+
+    return SCHEDULER_OK;
+}
+
+void
+scheduler_add(struct scheduler* sched, struct scheduler_task* task, struct chip8* chip8)
+{
+    assert(sched != NULL);
+    assert(task != NULL);
+    assert(chip8 != NULL);
+
+    pthread_mutex_lock(&sched->lock);
+    task->chip8 = chip8;
+    task->input = chip8_input_mask(chip8);
+    task->woken = false;
+    task->sleeping = false;
+    clock_gettime(SCHEDULER_CLOCK, &task->due);
+    scheduler_enqueue(sched, task);
+    pthread_mutex_unlock(&sched->lock);
+}
+
+void
+scheduler_input(struct scheduler* sched, struct scheduler_task* task, int key, bool pressed)
+{
+    assert(sched != NULL);
+    assert(task != NULL);
+    assert(key >= 0 && key < CHIP8_INPUT_SIZE);
+
+    pthread_mutex_lock(&sched->lock);
+    if (pressed) {
+        task->input |= 1 << key;
+    } else {
+        task->input &= ~(1 << key);
+    }
+
+    // input is applied when the task next runs, so a parked or sleeping
+    // task is made ready now and a running one is kept from parking
+    if (task->state == SCHEDULER_STATE_PARKED || (task->state == SCHEDULER_STATE_READY && task->sleeping)) {
+        if (task->state == SCHEDULER_STATE_READY) scheduler_dequeue(sched, task);
+        clock_gettime(SCHEDULER_CLOCK, &task->due);
+        scheduler_enqueue(sched, task);
+    } else if (task->state == SCHEDULER_STATE_RUNNING) {
+        task->woken = true;
+    }
+    pthread_mutex_unlock(&sched->lock);
+}
+
+int
+scheduler_state(struct scheduler* sched, const struct scheduler_task* task, int* yield)
+{
+    assert(sched != NULL);
+    assert(task != NULL);
+
+    pthread_mutex_lock(&sched->lock);
+    int state = task->state;
+    if (yield != NULL) *yield = task->yield;
+    pthread_mutex_unlock(&sched->lock);
+
+    return state;
+}
+
+void
+scheduler_stop(struct scheduler* sched)
+{
+    assert(sched != NULL);
+
+    pthread_mutex_lock(&sched->lock);
+    sched->stopping = true;
+    pthread_cond_broadcast(&sched->ready);
+    pthread_mutex_unlock(&sched->lock);
+
+    for (long i = 0; i < sched->num_workers; i++) {
+        pthread_join(sched->workers[i], NULL);
+    }
+
+    pthread_cond_destroy(&sched->ready);
+    pthread_mutex_destroy(&sched->lock);
+    free(sched->workers);
+    sched->workers = NULL;
+    sched->num_workers = 0;
+}
@@ -0,0 +1,71 @@
+#ifndef SKYLARK_SCHEDULER_H_INCLUDED
+#define SKYLARK_SCHEDULER_H_INCLUDED
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "chip8.h"
+
+enum scheduler_status {
+    SCHEDULER_OK = 0,
+    SCHEDULER_ERROR_ALLOC,
+    SCHEDULER_ERROR_THREAD,
+};
+
+enum scheduler_state {
+    SCHEDULER_STATE_READY = 0,
+    SCHEDULER_STATE_RUNNING,
+    SCHEDULER_STATE_PARKED,
+    SCHEDULER_STATE_HALTED,
+};
+
+enum scheduler_yield {
+    SCHEDULER_YIELD_FRAME = 0,
+    SCHEDULER_YIELD_KEY_WAIT,
+    SCHEDULER_YIELD_IDLE,
+    SCHEDULER_YIELD_FAULT,
+};
+
+struct scheduler_task;
+typedef void (*scheduler_frame_func)(struct scheduler_task* task);
+
+// A task is one machine multiplexed onto the scheduler's workers. It runs
+// a frame at a time and is parked, using no CPU, while it waits on Fx0A
+// or spins on a jump to itself, until scheduler_input wakes it back up.
+// Its timers catch up on the frames it spent parked when it next runs,
+// and while its sound timer is running it sleeps only until that ends.
+struct scheduler_task {
+    struct chip8* chip8;
+    scheduler_frame_func on_frame;
+    void* user;
+
+    struct scheduler_task* next;
+    struct timespec due;
+    struct timespec parked;  // when it last stopped running frames
+    int state;
+    int yield;
+    uint16_t input;
+    bool woken;
+    bool sleeping;           // parked, or queued only to end its sound
+};
+
+struct scheduler {
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    pthread_t* workers;
+    long num_workers;
+
+    struct scheduler_task* head;
+    long frame_ns;
+    bool stopping;
+};
+
+int scheduler_init(struct scheduler* sched, long num_workers);
+void scheduler_add(struct scheduler* sched, struct scheduler_task* task, struct chip8* chip8);
+void scheduler_input(struct scheduler* sched, struct scheduler_task* task, int key, bool pressed);
+int scheduler_state(struct scheduler* sched, const struct scheduler_task* task, int* yield);
+void scheduler_stop(struct scheduler* sched);
+
+#endif
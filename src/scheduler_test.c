@@ -0,0 +1,139 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "scheduler.c"
+
+static bool
+scheduler_test_wait(struct scheduler* sched, struct scheduler_task* task, int want_yield)
+{
+    // give the worker up to a second to run the task into a parked state
+    for (long i = 0; i < 1000; i++) {
+        int yield = 0;
+        int state = scheduler_state(sched, task, &yield);
+        if (state == SCHEDULER_STATE_PARKED && yield == want_yield) return true;
+
+        struct timespec ms = { .tv_nsec = 1000000 };
+        nanosleep(&ms, NULL);
+    }
+    return false;
+}
+
+bool
+test_scheduler_park(void)
+{
+    // LD V1, K followed by a jump to itself
+    const uint8_t rom[] = { 0xf1, 0x0a, 0x12, 0x02 };
+
+    struct chip8 chip8 = { 0 };
+    chip8_init(&chip8);
+    chip8_load(&chip8, rom, sizeof(rom));
+
+    struct scheduler sched = { 0 };
+    if (scheduler_init(&sched, 1) != SCHEDULER_OK) {
+        fprintf(stderr, "scheduler_init failed to start workers\n");
+        return false;
+    }
+
+    struct scheduler_task task = { 0 };
+    scheduler_add(&sched, &task, &chip8);
+
+    bool ok = true;
+    if (!scheduler_test_wait(&sched, &task, SCHEDULER_YIELD_KEY_WAIT)) {
+        fprintf(stderr, "sched did not park a task waiting on a key\n");
+        ok = false;
+    }
+
+    scheduler_input(&sched, &task, 0x5, true);
+    if (ok && !scheduler_test_wait(&sched, &task, SCHEDULER_YIELD_IDLE)) {
+        fprintf(stderr, "sched did not wake a task on input and park it when idle\n");
+        ok = false;
+    }
+
+    // an extended machine waiting on a key far past classic memory
+    struct chip8 extended = { 0 };
+    chip8_init(&extended);
+    chip8_load(&extended, rom, sizeof(rom));
+    struct scheduler_task extended_task = { 0 };
+    if (ok && chip8_extend(&extended) == CHIP8_OK) {
+        extended.xmem[0xf000] = 0xf1;
+        extended.xmem[0xf001] = 0x0a;
+        extended.pc = 0xf000;
+        scheduler_add(&sched, &extended_task, &extended);
+        if (!scheduler_test_wait(&sched, &extended_task, SCHEDULER_YIELD_KEY_WAIT)) {
+            fprintf(stderr, "sched did not park an extended task waiting on a key\n");
+            ok = false;
+        }
+    }
+
+    scheduler_stop(&sched);
+    chip8_free(&extended);
+
+    if (ok && chip8.reg[1] != 0x5) {
+        fprintf(stderr, "sched did not deliver the pressed key\n");
+        ok = false;
+    }
+
+    return ok;
+}
+
+bool
+test_scheduler_timers(void)
+{
+    const uint8_t rom[] = {
+        0x60, 0x06,  // 200: LD V0, 06
+        0x62, 0x3c,  // 202: LD V2, 3C
+        0xf0, 0x18,  // 204: LD ST, V0
+        0xf2, 0x15,  // 206: LD DT, V2
+        0xf1, 0x0a,  // 208: LD V1, K
+        0x12, 0x0a,  // 20a: JP 20a
+    };
+
+    struct chip8 chip8 = { 0 };
+    chip8_init(&chip8);
+    chip8_load(&chip8, rom, sizeof(rom));
+    chip8_set_timing(&chip8, CHIP8_TIMING_VIP);
+
+    struct scheduler sched = { 0 };
+    if (scheduler_init(&sched, 1) != SCHEDULER_OK) {
+        fprintf(stderr, "scheduler_init failed to start workers\n");
+        return false;
+    }
+
+    struct scheduler_task task = { 0 };
+    scheduler_add(&sched, &task, &chip8);
+
+    // the key wait only parks for good once the sound has run out
+    bool ok = true;
+    if (!scheduler_test_wait(&sched, &task, SCHEDULER_YIELD_KEY_WAIT)) {
+        fprintf(stderr, "sched did not park a task waiting on a key\n");
+        ok = false;
+    }
+    pthread_mutex_lock(&sched.lock);
+    if (ok && chip8.timer_sound != 0) {
+        fprintf(stderr, "sched parked a task with its sound timer at %d\n", chip8.timer_sound);
+        ok = false;
+    }
+    pthread_mutex_unlock(&sched.lock);
+
+    // a fifth of a second parked takes about 12 frames off the delay timer
+    struct timespec wait = { .tv_nsec = 200000000 };
+    nanosleep(&wait, NULL);
+    scheduler_input(&sched, &task, 0x5, true);
+    if (ok && !scheduler_test_wait(&sched, &task, SCHEDULER_YIELD_IDLE)) {
+        fprintf(stderr, "sched did not wake a task on input and park it when idle\n");
+        ok = false;
+    }
+
+    scheduler_stop(&sched);
+
+    if (ok && chip8.timer_delay > 0x3c - 12) {
+        fprintf(stderr, "delay timer is %d after parking\n", chip8.timer_delay);
+        ok = false;
+    }
+
+    return ok;
+}
@@ -0,0 +1,138 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "telemetry.h"
+
+enum {
+    TELEMETRY_NS_PER_US = 1000,
+    TELEMETRY_NS_PER_SEC = 1000000000,
+};
+
+static void
+telemetry_write_family(FILE* fp, const char* name, const char* type, const char* help)
+{
+    // every metric family gets its own HELP and TYPE lines so a collector
+    // does not ingest it as untyped
+    fprintf(fp, "# HELP skylark_%s %s\n", name, help);
+    fprintf(fp, "# TYPE skylark_%s %s\n", name, type);
+}
+
+static void
+telemetry_write_histogram(FILE* fp, const char* name, const char* help, const struct telemetry_histogram* histogram)
+{
+    char family[64] = { 0 };
+    snprintf(family, sizeof(family), "%s_us", name);
+    telemetry_write_family(fp, family, "histogram", help);
+
+    // buckets are written cumulatively, as the Prometheus text format expects
+    uint64_t total = 0;
+    for (long i = 0; i < TELEMETRY_BUCKETS; i++) {
+        total += histogram->buckets[i];
+        fprintf(fp, "skylark_%s_us_bucket{le=\"%lu\"} %llu\n",
+            name, 1ul << i, (unsigned long long)total);
+    }
+    fprintf(fp, "skylark_%s_us_bucket{le=\"+Inf\"} %llu\n", name, (unsigned long long)histogram->count);
+    fprintf(fp, "skylark_%s_us_sum %llu\n", name, (unsigned long long)(histogram->sum_ns / TELEMETRY_NS_PER_US));
+    fprintf(fp, "skylark_%s_us_count %llu\n", name, (unsigned long long)histogram->count);
+
+    // the maximum is not part of the histogram family, so it is its own gauge
+    snprintf(family, sizeof(family), "%s_max_us", name);
+    telemetry_write_family(fp, family, "gauge", "Longest duration recorded, in microseconds.");
+    fprintf(fp, "skylark_%s_max_us %llu\n", name, (unsigned long long)(histogram->max_ns / TELEMETRY_NS_PER_US));
+}
+
+void
+telemetry_init(struct telemetry* telemetry, const char* path, uint64_t now_ns)
+{
+    assert(telemetry != NULL);
+
+    memset(telemetry, 0, sizeof(*telemetry));
+    telemetry->start_ns = now_ns;
+    telemetry->publish_ns = now_ns;
+    telemetry->interval_ns = TELEMETRY_NS_PER_SEC;
+    if (path != NULL) snprintf(telemetry->path, sizeof(telemetry->path), "%s", path);
+}
+
+void
+telemetry_record(struct telemetry_histogram* histogram, uint64_t ns)
+{
+    // find the smallest power of two at or above the duration, rounding up
+    // to whole microseconds so a bucket never holds anything past its bound
+    uint64_t us = (ns + TELEMETRY_NS_PER_US - 1) / TELEMETRY_NS_PER_US;
+    long bucket = 0;
+    while (bucket < TELEMETRY_BUCKETS && (UINT64_C(1) << bucket) < us) bucket++;
+
+    if (bucket < TELEMETRY_BUCKETS) histogram->buckets[bucket] += 1;
+    histogram->count += 1;
+    histogram->sum_ns += ns;
+    if (ns > histogram->max_ns) histogram->max_ns = ns;
+}
+
+int
+telemetry_publish(struct telemetry* telemetry, uint64_t now_ns)
+{
+    assert(telemetry != NULL);
+
+    if (telemetry->path[0] == '\0') return TELEMETRY_OK;
+    if (now_ns - telemetry->publish_ns < telemetry->interval_ns) return TELEMETRY_OK;
+
+    uint64_t elapsed_ns = now_ns - telemetry->publish_ns;
+    uint64_t instructions = telemetry->instructions - telemetry->publish_instructions;
+    uint64_t idle_ns = telemetry->idle_ns - telemetry->publish_idle_ns;
+
+    // instructions per microsecond is millions of instructions per second
+    double mips = (double)instructions / ((double)elapsed_ns / TELEMETRY_NS_PER_US);
+    double idle = (double)idle_ns / (double)elapsed_ns;
+
+    telemetry->publish_ns = now_ns;
+    telemetry->publish_instructions = telemetry->instructions;
+    telemetry->publish_idle_ns = telemetry->idle_ns;
+
+    // write a temporary file and rename it into place so that a collector
+    // never sees a partially written snapshot
+    char tmp[TELEMETRY_PATH_SIZE + 8] = { 0 };
+    snprintf(tmp, sizeof(tmp), "%s.tmp", telemetry->path);
+
+    FILE* fp = fopen(tmp, "w");
+    if (fp == NULL) return TELEMETRY_ERROR_WRITE;
+
+    telemetry_write_family(fp, "uptime_seconds", "gauge", "Seconds since the emulator started.");
+    fprintf(fp, "skylark_uptime_seconds %.3f\n", (double)(now_ns - telemetry->start_ns) / TELEMETRY_NS_PER_SEC);
+    telemetry_write_family(fp, "instructions_total", "counter", "Instructions executed.");
+    fprintf(fp, "skylark_instructions_total %llu\n", (unsigned long long)telemetry->instructions);
+    telemetry_write_family(fp, "mips", "gauge", "Millions of instructions per second since the last snapshot.");
+    fprintf(fp, "skylark_mips %.6f\n", mips);
+    telemetry_write_family(fp, "frames_presented_total", "counter", "Frames presented to the window.");
+    fprintf(fp, "skylark_frames_presented_total %llu\n", (unsigned long long)telemetry->frames_presented);
+    telemetry_write_family(fp, "frames_dropped_total", "counter", "Frames skipped because a frame ran past its deadline.");
+    fprintf(fp, "skylark_frames_dropped_total %llu\n", (unsigned long long)telemetry->frames_dropped);
+    telemetry_write_family(fp, "idle_ratio", "gauge", "Fraction of time spent idle since the last snapshot.");
+    fprintf(fp, "skylark_idle_ratio %.6f\n", idle);
+    telemetry_write_histogram(fp, "frame_time", "Time spent on a frame before pacing, in microseconds.", &telemetry->frame_time);
+    telemetry_write_histogram(fp, "present_time", "Time to present a frame, in microseconds.", &telemetry->present_time);
+    telemetry_write_histogram(fp, "input_latency", "Time from a key event to the next presented frame, in microseconds.",
+        &telemetry->input_latency);
+
+    if (fclose(fp) != 0) return TELEMETRY_ERROR_WRITE;
+
+#ifdef _WIN32
+    // rename does not replace an existing file on Windows
+    remove(telemetry->path);
+#endif
+    if (rename(tmp, telemetry->path) != 0) return TELEMETRY_ERROR_WRITE;
+
+    return TELEMETRY_OK;
+}
+
+const char*
+telemetry_error_message(int error)
+{
+    switch (error) {
+    case TELEMETRY_OK: return "OK";
+    case TELEMETRY_ERROR_WRITE: return "failed to write metrics file";
+    default: return "unknown error";
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef SKYLARK_TELEMETRY_H_INCLUDED
+#define SKYLARK_TELEMETRY_H_INCLUDED
+
+#include <stdbool.h>
+#include <stdint.h>
+
+enum {
+    TELEMETRY_BUCKETS = 24,
+    TELEMETRY_PATH_SIZE = 4096,
+};
+
+enum telemetry_status {
+    TELEMETRY_OK = 0,
+    TELEMETRY_ERROR_WRITE,
+};
+
+// Histogram of durations with power-of-two microsecond buckets:
+// bucket n counts durations of at most 2^n microseconds that did not fit
+// in bucket n - 1. Anything longer than the last bucket is only counted
+// in the total.
+struct telemetry_histogram {
+    uint64_t buckets[TELEMETRY_BUCKETS];
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+};
+
+// A telemetry block is owned by the one thread that updates it, so every
+// update is a plain increment with no locks or atomics. The owner
+// periodically publishes a snapshot by rewriting a file that a collector
+// can scrape at any time without pausing emulation.
+struct telemetry {
+    uint64_t instructions;
+    uint64_t frames_presented;
+    uint64_t frames_dropped;
+    uint64_t idle_ns;
+
+    struct telemetry_histogram frame_time;
+    uint64_t input_ns;
+    struct telemetry_histogram present_time;
+    struct telemetry_histogram input_latency;
+
+    uint64_t start_ns;
+    uint64_t publish_ns;
+    uint64_t publish_instructions;
+    uint64_t publish_idle_ns;
+    uint64_t interval_ns;
+    bool reported;  // the host has already reported a failed publish
+    char path[TELEMETRY_PATH_SIZE];
+};
+
+void telemetry_init(struct telemetry* telemetry, const char* path, uint64_t now_ns);
+void telemetry_record(struct telemetry_histogram* histogram, uint64_t ns);
+int telemetry_publish(struct telemetry* telemetry, uint64_t now_ns);
+const char* telemetry_error_message(int error);
+
+#endif
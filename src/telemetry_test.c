@@ -0,0 +1,78 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "telemetry.c"
+
+bool
+test_telemetry_publish(void)
+{
+    const char* path = "skylark_telemetry_test.prom";
+
+    struct telemetry telemetry;
+    telemetry_init(&telemetry, path, 0);
+    telemetry.instructions = 600;
+
+    // exact powers of two land in their own bucket, and anything past the
+    // last bucket only counts toward the total
+    const uint64_t us[] = { 1, 2, 3, 4, 1 << 23, (1 << 23) + 1 };
+    for (size_t i = 0; i < sizeof(us) / sizeof(*us); i++) {
+        telemetry_record(&telemetry.frame_time, us[i] * TELEMETRY_NS_PER_US);
+    }
+    const struct telemetry_histogram* h = &telemetry.frame_time;
+    if (h->buckets[0] != 1 || h->buckets[1] != 1 || h->buckets[2] != 2 || h->buckets[23] != 1 || h->count != 6) {
+        fprintf(stderr, "telemetry_record put durations in the wrong buckets\n");
+        return false;
+    }
+
+    // nothing is written before the interval is up
+    remove(path);
+    if (telemetry_publish(&telemetry, 1) != TELEMETRY_OK || remove(path) == 0) {
+        fprintf(stderr, "telemetry_publish wrote before its interval\n");
+        return false;
+    }
+
+    int rc = telemetry_publish(&telemetry, TELEMETRY_NS_PER_SEC);
+    if (rc != TELEMETRY_OK) {
+        fprintf(stderr, "telemetry_publish failed: %s\n", telemetry_error_message(rc));
+        return false;
+    }
+
+    char text[8192] = { 0 };
+    FILE* fp = fopen(path, "r");
+    if (fp != NULL) {
+        fread(text, 1, sizeof(text) - 1, fp);
+        fclose(fp);
+    }
+    remove(path);
+
+    const char* lines[] = {
+        "\n# TYPE skylark_instructions_total counter\nskylark_instructions_total 600\n",
+        "\nskylark_mips 0.000600\n",
+        "\n# TYPE skylark_frame_time_us histogram\nskylark_frame_time_us_bucket{le=\"1\"} 1\n",
+        "\nskylark_frame_time_us_bucket{le=\"2\"} 2\n",
+        "\nskylark_frame_time_us_bucket{le=\"4\"} 4\n",
+        "\nskylark_frame_time_us_bucket{le=\"8388608\"} 5\n",
+        "\nskylark_frame_time_us_bucket{le=\"+Inf\"} 6\n",
+        "\nskylark_frame_time_us_count 6\n",
+        "\n# TYPE skylark_frame_time_max_us gauge\nskylark_frame_time_max_us 8388609\n",
+    };
+    for (size_t i = 0; i < sizeof(lines) / sizeof(*lines); i++) {
+        if (strstr(text, lines[i]) == NULL) {
+            fprintf(stderr, "published metrics are missing:%s", lines[i]);
+            return false;
+        }
+    }
+
+    // a path that cannot be written is reported
+    telemetry_init(&telemetry, "skylark_telemetry_test/missing/metrics.prom", 0);
+    if (telemetry_publish(&telemetry, TELEMETRY_NS_PER_SEC) != TELEMETRY_ERROR_WRITE) {
+        fprintf(stderr, "telemetry_publish did not report an unwritable path\n");
+        return false;
+    }
+
+    return true;
+}